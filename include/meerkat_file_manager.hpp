@@ -12,29 +12,205 @@
 #include "stdio.h"
 #include "stdarg.h"
 #include "string.h"
+#include "limits.h"
+#include "errno.h"
 #include <vector>
 #include <string>
 #include <map>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_map>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace meerkat {
 
 class mk_file_manager
 {
+public:
+    /**
+     * @brief The mk_line struct  View of a line without the line break. It points into the file
+     *                            mapping (valid until the file is closed) or into an internal
+     *                            buffer (valid until the next read).
+     */
+    struct mk_line
+    {
+        const char *_data;                // First character of the line.
+        size_t _size;                     // Number of characters.
+
+        /**
+         * @brief str  Copies the line into a string.
+         * @return     The line.
+         */
+        std::string str() const;
+    };
+
+    /** Enums */
+    enum ColumnType {Token, Label, Unsigned, Real};  // Column types of chunked reading.
+    enum Status {Ok, NotReadable, NotWritable, ReadFailed, WriteFailed, Corrupt};  // Failures.
+
+    /**
+     * @brief The mk_column struct  Values of a column in a chunk, only the vector of the column
+     *                              type is filled.
+     */
+    struct mk_column
+    {
+        int _type;                             // Column type.
+        std::vector<mk_line> _tokens;          // Token: fields as they are.
+        std::vector<int> _labels;              // Label: ids in the label table of the chunk.
+        std::vector<unsigned long> _integers;  // Unsigned: values.
+        std::vector<double> _reals;            // Real: values.
+    };
+
+    /**
+     * @brief The mk_chunk struct  Records parsed from a range of lines in columnar form. Tokens
+     *                             point into the file mapping or into the text of the chunk.
+     */
+    struct mk_chunk
+    {
+        size_t _index;                    // Position of the chunk in the file.
+        size_t _offset;                   // Byte offset of the first line in the file.
+        size_t _rows;                     // Number of valid records.
+        size_t _invalid;                  // Number of lines skipped as invalid.
+        std::vector<mk_column> _columns;  // Columns.
+        std::vector<mk_line> _labels;     // Distinct labels in the order of first appearance.
+        std::vector<char> _text;          // Text of the lines if the file is not mapped.
+    };
+
+    /**
+     * @brief The mk_block struct  Block of a binary columnar file. Values point into the file
+     *                             mapping (valid until the file is closed).
+     */
+    struct mk_block
+    {
+        size_t _rows;                            // Number of rows.
+        std::vector<const double*> _reals;       // Values of Real columns (NULL for others).
+        std::vector<const uint64_t*> _integers;  // Values of Unsigned columns (NULL for others).
+    };
+
 private:
     /** Enums */
-    enum FileState {Empty, Write, Read};  // File pointer states.
+    enum FileState {Empty, Write, Read, Mapped};  // File pointer states.
+    enum Codec {Plain, Lz, Gzip};                 // Compression of files.
+
+    /**
+     * @brief The __decoder struct  State of reading a compressed file: a thread decompresses the
+     *                              file into a pipe that is read as a normal file.
+     */
+    struct __decoder
+    {
+        int _codec;                   // Codec of the file.
+        FILE *_source;                // Compressed file.
+        int _pipe;                    // Write end of the pipe.
+        std::atomic<bool> _stop;      // Whether decompression should stop.
+        std::atomic<bool> _failed;    // Whether the file is corrupt or truncated.
+        std::thread _thread;          // Decompressing thread.
+    };
+
+    /**
+     * @brief The __encoder struct  State of writing a compressed file.
+     */
+    struct __encoder
+    {
+        int _codec;                   // Codec of the file.
+        void *_stream;                // Compression stream (Gzip only).
+        std::vector<char> _buffer;    // Compressed data.
+        std::vector<uint32_t> _table; // Hash table of the match finder (Lz only).
+    };
+
+    /**
+     * @brief The __async_writer struct  State of the asynchronous write mode: a single-producer
+     *                                   single-consumer ring of output blocks, written in file by
+     *                                   a background thread.
+     */
+    struct __async_writer
+    {
+        std::vector<std::vector<char> > _blocks;  // Ring of output blocks.
+        std::vector<size_t> _sizes;               // Number of characters in each block.
+        std::atomic<size_t> _head;                // Number of blocks submitted.
+        std::atomic<size_t> _tail;                // Number of blocks written in file.
+        std::atomic<bool> _closing;               // Whether the writer should stop when empty.
+        std::atomic<bool> _failed;                // Whether a write failed.
+        FILE *_pointer;                           // Pointer to the file.
+        __encoder *_encoder;                      // Compression of output (NULL if none).
+        std::mutex _mutex;                        // Lock for sleeping only.
+        std::condition_variable _submitted;       // Signals a submitted block.
+        std::condition_variable _written;         // Signals a written block.
+        std::thread _thread;                      // Writer thread.
+    };
+
+    /**
+     * @brief The __chunk_reader struct  State of the parallel chunked reading.
+     */
+    struct __chunk_reader
+    {
+        std::vector<int> _types;               // Column types.
+        int _required;                         // Number of columns a valid record must have.
+        char _separator;                       // Extra separator besides blanks.
+        const char *_begin;                    // First character to read (mapped only).
+        const char *_end;                      // End of the mapped content.
+        size_t _base;                          // Byte offset of the first character to read.
+        size_t _chunkSize;                     // Approximate size of a chunk in bytes.
+        size_t _numChunks;                     // Number of chunks.
+        size_t _claimed;                       // Number of chunks taken by the workers.
+        size_t _next;                          // Index of the next chunk to hand over.
+        size_t _window;                        // Maximum number of chunks ahead of the consumer.
+        bool _stop;                            // Whether the workers should stop.
+        std::map<size_t, mk_chunk> _done;      // Parsed chunks waiting for the consumer.
+        std::vector<std::thread> _workers;     // Worker threads.
+        std::mutex _mutex;                     // Lock of the shared state.
+        std::condition_variable _parsed;       // Signals a parsed chunk.
+        std::condition_variable _consumed;     // Signals a chunk handed over.
+    };
 
     FILE *_pointer;                       // Pointer to the file.
-    int _state;                           // State of the pointer (Empty, Read or Write).
+    int _state;                           // State of the pointer (Empty, Read, Write or Mapped).
     std::string _fileName;                // Name of the file.
+    const char *_map;                     // Mapped content of the file (Mapped only).
+    size_t _mapSize;                      // Size of the mapped content.
+    size_t _cursor;                       // Position of the next line in the mapped content.
+    char *_line;                          // Line buffer, grows to the longest line (Read only).
+    size_t _lineCapacity;                 // Capacity of the line buffer.
+    size_t _offset;                       // Decompressed bytes read (compressed Read only).
+    mutable int _status;                  // Status of the last failure (Status).
+    std::vector<char> _out;               // Output buffer (Write only).
+    size_t _outSize;                      // Number of characters in the output buffer.
+    int _precision;                       // Significant digits of written numbers (0: shortest
+                                          // representation that reads back exactly).
+    std::vector<int> _columnTypes;        // Column types of a binary columnar file.
+    int _blockRows;                       // Maximum number of rows in a block.
+    std::vector<uint64_t> _block;         // Values of the current block (column-major).
+    int _blockSize;                       // Number of rows in the current block.
+    __decoder *_decoder;                  // Decompression of input (NULL if not compressed).
+    __encoder *_encoder;                  // Compression of output (NULL if not compressed).
+    uint64_t _identity[3];                // Modification time (s, ns) and inode of the mapped
+                                          // file, checked against the sidecar index.
+    bool _sidecar;                        // Whether the line index is stored next to the file.
+    mutable std::vector<size_t> _offsets; // Start offsets of the lines (Mapped only).
+    mutable bool _isIndexed;              // Whether the line index is built.
+    __chunk_reader *_chunks;              // Parallel chunked reading (NULL if not started).
+    __async_writer *_async;               // Asynchronous writing (NULL if writing directly).
 
     /**
-     * @brief perror    Prints an error message to the standard I/O.
+     * @brief _error    Prints an error message to the standard I/O and records the status, the
+     *                  file stays open.
      * @param message_  Message to show.
+     * @param status_   Status of the failure.
      */
-    void _error( const char *message_ ) const;
+    void _error( const char *message_, int status_ ) const;
 
     /**
      * @brief _open      Opens a file for a given operation.
@@ -44,6 +220,229 @@ private:
      */
     bool _open( const std::string fileName_, FileState mode_ );
 
+    /**
+     * @brief _read_line  Reads the next line into the line buffer, growing it if necessary.
+     * @return            Length of the line including the line break, -1 at the end of file.
+     */
+    long _read_line();
+
+    /**
+     * @brief _index  Builds the line index of the mapped file, or loads it from the sidecar file
+     *                (<file name>.idx) if enabled and up to date.
+     */
+    void _index() const;
+
+    /**
+     * @brief _sample_hash  Hashes the first and last blocks of the mapped file, so that a
+     *                      rewrite of the same size within the same timestamp is detected.
+     * @return              FNV-1a hash of the sampled bytes.
+     */
+    uint64_t _sample_hash() const;
+
+    /**
+     * @brief _load_index  Loads the line index from the sidecar file.
+     * @return             True if the sidecar file exists and matches the size, modification
+     *                     time, inode and sample hash of the mapped file.
+     */
+    bool _load_index() const;
+
+    /**
+     * @brief _save_index  Saves the line index to the sidecar file.
+     */
+    void _save_index() const;
+
+    /**
+     * @brief _scan_lines  Collects the start offsets of the lines that start after a line break
+     *                     in a part of the mapped file.
+     * @param map_         Mapped content.
+     * @param size_        Size of the mapped content.
+     * @param begin_       Offset of the first character to scan.
+     * @param end_         Offset past the last character to scan.
+     * @param offsets_     Offsets will be appended here.
+     */
+    static void _scan_lines( const char *map_, size_t size_, size_t begin_, size_t end_,
+                             std::vector<size_t> *offsets_ );
+
+    /**
+     * @brief _field_end  Finds the end of a field (first blank or separator), 16 characters at a
+     *                    time with SSE2.
+     * @param pos_        First character of the field.
+     * @param end_        End of text.
+     * @param separator_  Extra separator besides blanks.
+     * @return            Position of the first blank or separator, or end of text.
+     */
+    static const char *_field_end( const char *pos_, const char *end_, char separator_ );
+
+    /**
+     * @brief _field_begin  Skips blanks and at most one separator before a field.
+     * @param pos_          Position to skip from, it is updated.
+     * @param end_          End of text.
+     * @param separator_    Extra separator besides blanks.
+     * @return              True if there is a field, false at the end of text.
+     */
+    static bool _field_begin( const char *&pos_, const char *end_, char separator_ );
+
+    /**
+     * @brief _chunk_begin  Finds the first line of a chunk, that is the first line starting at or
+     *                      after the nominal chunk boundary.
+     * @param reader_       Chunk reader.
+     * @param chunk_        Index of the chunk.
+     * @return              Position of the first line, or end of content.
+     */
+    static const char *_chunk_begin( const __chunk_reader *reader_, size_t chunk_ );
+
+    /**
+     * @brief _parse_chunk  Parses lines into the columns of a chunk. Lines without the required
+     *                      columns are invalid, missing or invalid optional values are zero.
+     * @param reader_       Chunk reader with the column types.
+     * @param begin_        First character of the lines.
+     * @param end_          End of the lines.
+     * @param chunk_        Chunk to fill, its text is not touched.
+     */
+    static void _parse_chunk( const __chunk_reader *reader_, const char *begin_, const char *end_,
+                              mk_chunk &chunk_ );
+
+    /**
+     * @brief _chunk_worker  Worker thread of the chunked reading, parses chunks in turn until all
+     *                       are taken or reading is stopped.
+     * @param reader_        Chunk reader.
+     */
+    static void _chunk_worker( __chunk_reader *reader_ );
+
+    /**
+     * @brief _reserve  Makes room in the output buffer, flushing it if necessary.
+     * @param size_     Number of characters to make room for.
+     * @return          Position to write at.
+     */
+    char *_reserve( size_t size_ );
+
+    /**
+     * @brief _write_out  Writes the output buffer in file, or submits it to the writer thread in
+     *                    asynchronous mode (waiting while all blocks are in use).
+     * @return            True if no write has failed, false otherwise.
+     */
+    bool _write_out();
+
+    /**
+     * @brief _async_worker  Writer thread of the asynchronous mode, writes blocks in order until
+     *                       closing and all blocks are written.
+     * @param writer_        Asynchronous writer.
+     */
+    static void _async_worker( __async_writer *writer_ );
+
+    /**
+     * @brief _stop_async  Writes all submitted blocks and stops the writer thread.
+     */
+    void _stop_async();
+
+    /**
+     * @brief _put_block  Writes the current block of a binary columnar file into the output
+     *                    buffer.
+     */
+    void _put_block();
+
+    /**
+     * @brief _codec_of  Determines the codec of a regular file from its first bytes.
+     * @param file_      File, it is rewound.
+     * @return           Codec of the file.
+     */
+    static int _codec_of( FILE *file_ );
+
+    /**
+     * @brief _decode    Decompresses a file block by block.
+     * @param source_    Compressed file.
+     * @param codec_     Codec of the file.
+     * @param sink_      Function receiving the decompressed blocks, returns false to stop.
+     * @param context_   Context passed to the sink.
+     * @return           True if the whole file could be decompressed, false otherwise.
+     */
+    static bool _decode( FILE *source_, int codec_,
+                         bool (*sink_)(const char*, size_t, void*), void *context_ );
+
+    /**
+     * @brief _encode    Compresses a block of output and writes it in file.
+     * @param encoder_   Encoder (NULL to write uncompressed).
+     * @param file_      File to write in.
+     * @param data_      Block of output.
+     * @param size_      Size of the block.
+     * @param finish_    Whether to finish the compressed stream.
+     * @return           True if block could be written, false otherwise.
+     */
+    static bool _encode( __encoder *encoder_, FILE *file_, const char *data_, size_t size_,
+                         bool finish_ );
+
+    /**
+     * @brief _lz_compress   Compresses a block in LZ4 block format (literals and matches of at
+     *                       least 4 bytes within 64 kB).
+     * @param source_        Block to compress.
+     * @param size_          Size of the block.
+     * @param destination_   Compressed block, at least size_ + size_/255 + 16 bytes.
+     * @param table_         Hash table of 65536 entries.
+     * @return               Size of the compressed block.
+     */
+    static size_t _lz_compress( const char *source_, size_t size_, char *destination_,
+                                uint32_t *table_ );
+
+    /**
+     * @brief _lz_decompress  Decompresses a block in LZ4 block format, checking bounds.
+     * @param source_         Compressed block.
+     * @param size_           Size of the compressed block.
+     * @param destination_    Decompressed block.
+     * @param rawSize_        Size of the decompressed block.
+     * @return                True if the block is valid, false otherwise.
+     */
+    static bool _lz_decompress( const char *source_, size_t size_, char *destination_,
+                                size_t rawSize_ );
+
+    /**
+     * @brief _pipe_sink  Writes a decompressed block into the pipe of a decoder.
+     * @param data_       Decompressed block.
+     * @param size_       Size of the block.
+     * @param decoder_    Decoder.
+     * @return            True if block could be written, false if decoding should stop.
+     */
+    static bool _pipe_sink( const char *data_, size_t size_, void *decoder_ );
+
+    /**
+     * @brief _decode_worker  Decompressing thread, decompresses the file into the pipe and closes
+     *                        the pipe.
+     * @param decoder_        Decoder.
+     */
+    static void _decode_worker( __decoder *decoder_ );
+
+    /**
+     * @brief _start_decoder  Starts decompressing a file, the read end of the pipe becomes the
+     *                        file pointer.
+     * @param source_         Compressed file.
+     * @param codec_          Codec of the file.
+     * @return                True if decompression could be started, false otherwise.
+     */
+    bool _start_decoder( FILE *source_, int codec_ );
+
+    /**
+     * @brief _stop_decoder  Stops decompressing and closes the pipe and the compressed file.
+     */
+    void _stop_decoder();
+
+    /**
+     * @brief _stop_encoder  Finishes the compressed stream of the output.
+     */
+    void _stop_encoder();
+
+    /**
+     * @brief _format  Formats a number into the output buffer.
+     * @param value_   Number to format.
+     * @param after_   Character to write after the number.
+     */
+    void _format( double value_, char after_ );
+
+    /**
+     * @brief _put_row  Writes a row of numbers separated by spaces into the output buffer.
+     * @param data_     Numbers to write.
+     * @param size_     Number of numbers.
+     */
+    void _put_row( const double *data_, int size_ );
+
 public:
     /**
      * @brief mk_file_manager  Empty constructor, sets pointer to NULL.
@@ -56,18 +455,39 @@ public:
     ~mk_file_manager();
 
     /**
-     * @brief read       Opens a file for read.
+     * @brief read       Opens a file for read. Compressed files (in-tree LZ format, or gzip if
+     *                   compiled with MEERKAT_ZLIB and linked with -lz) are detected by their
+     *                   first bytes and decompressed on a separate thread while being read.
      * @param fileName_  File name.
      * @return           True if file could be open for read, false otherwise.
      */
     bool read( const std::string fileName_ );
 
     /**
-     * @brief write      Opens a file for write.
+     * @brief map        Opens a file for read by mapping it into memory. Lines can be read
+     *                   with next_line() without copying, all other read methods work as well.
+     * @param fileName_  File name.
+     * @param sidecar_   If true, the line index is stored in <file name>.idx and reused when
+     *                   the file is mapped again without being modified.
+     * @return           True if file could be open for read, false otherwise.
+     * @note             If the file cannot be mapped (e.g., it is a pipe or compressed), it is read
+     *                   normally.
+     */
+    bool map( const std::string fileName_, bool sidecar_ = false );
+
+    /**
+     * @brief write      Opens a file for write. Output is buffered and written in large blocks,
+     *                   it is flushed when the buffer is full, by flush() and by close().
      * @param fileName_  File name.
-     * @return           True if file could be open for write, false otherwise.
+     * @param async_     If true, full blocks are written by a background thread and put() only
+     *                   waits if all (4) blocks are waiting to be written. Output is written in
+     *                   order. put() must be called from one thread only.
+     *                   Files ending with .mkz are compressed with the in-tree LZ codec, files
+     *                   ending with .gz with gzip, compressed output is complete after close().
+     * @return           True if file could be open for write, false otherwise (also for .gz
+     *                   files if not compiled with MEERKAT_ZLIB, status is then NotWritable).
      */
-    bool write( const std::string fileName_ );
+    bool write( const std::string fileName_, bool async_ = false );
 
     /**
      * @brief close  Closes a file.
@@ -82,9 +502,61 @@ public:
     /**
      * @brief rows  Returns the number of rows in file.
      * @return      Number of rows if file is readable, -1 otherwise.
+     * @note        In mapped mode, the first call builds a line index (scanning the file in
+     *              parallel), later calls take O(1) time.
      */
     int rows() const;
 
+    /**
+     * @brief status  Returns the status of the last failure since the file was opened. Reading
+     *                methods return false (or empty) both at the end of file and on failure,
+     *                the status tells them apart.
+     * @return        Status (Ok if there was no failure).
+     */
+    int status() const;
+
+    /**
+     * @brief clear_status  Clears the status of the last failure.
+     */
+    void clear_status();
+
+    /**
+     * @brief offset  Returns the byte offset of the next line (in the decompressed content for
+     *                compressed files). After a failure it is the offset where reading stopped.
+     * @return        Offset of the next line.
+     */
+    size_t offset() const;
+
+    /**
+     * @brief seek_offset  Continues reading from a byte offset returned by offset(), e.g., to
+     *                     resume a job from a checkpoint.
+     * @param offset_      Offset to continue from.
+     * @return             True if offset could be reached, false otherwise.
+     */
+    bool seek_offset( size_t offset_ );
+
+    /**
+     * @brief mapped  Returns whether the file is read from a memory mapping.
+     * @return        True if file is mapped, false otherwise.
+     */
+    bool mapped() const;
+
+    /**
+     * @brief line     Retrieves a line by its index (mapped mode only), without moving the
+     *                 current line.
+     * @param lineId_  Index of the line.
+     * @param line_    The line (without line break) will be stored here.
+     * @return         True if line exists, false otherwise.
+     */
+    bool line( int lineId_, mk_line &line_ ) const;
+
+    /**
+     * @brief seek_line  Moves the current line to a given line (mapped mode only).
+     * @param lineId_    Index of the line, rows() moves to the end of file.
+     * @return           True if current line could be moved, false otherwise.
+     */
+    bool seek_line( int lineId_ );
+
     /**
      * @brief cols  Returns the number of columns in file.
      * @return      Number of columns if file is readable, -1 otherwise.
@@ -98,6 +570,72 @@ public:
      */
     bool put( std::vector<double> &data_ );
 
+    /**
+     * @brief put_rows  Writes the rows of a matrix in file.
+     * @param data_     Rows to write in file.
+     * @return          True if rows could be written in file, false otherwise.
+     */
+    bool put_rows( const std::vector<std::vector<double> > &data_ );
+
+    /**
+     * @brief put_rows  Writes the rows of a matrix stored in row-major order in file.
+     * @param data_     Values of the matrix.
+     * @param numRows_  Number of rows.
+     * @param numCols_  Number of columns.
+     * @return          True if rows could be written in file, false otherwise.
+     */
+    bool put_rows( const double *data_, int numRows_, int numCols_ );
+
+    /**
+     * @brief set_columns  Starts a binary columnar file by writing its header. The file consists
+     *                     of the header (magic "MKCOL1", number of columns, block size, type and
+     *                     name of each column) and blocks of at most blockRows_ rows, each
+     *                     storing the number of rows and the values of each column in turn as
+     *                     8-byte numbers (native byte order).
+     * @param names_       Column names.
+     * @param types_       Column types (Unsigned or Real).
+     * @param blockRows_   Maximum number of rows in a block.
+     * @return             True if the header could be written, false otherwise.
+     */
+    bool set_columns( const std::vector<std::string> &names_, const std::vector<int> &types_,
+                      int blockRows_ = 65536 );
+
+    /**
+     * @brief put_record  Writes a row in a binary columnar file.
+     * @param data_       Values of the columns, Unsigned values are rounded down.
+     * @return            True if row could be written, false otherwise.
+     */
+    bool put_record( const std::vector<double> &data_ );
+
+    /**
+     * @brief get_columns  Reads the header of a mapped binary columnar file.
+     * @param names_       Column names will be stored here.
+     * @param types_       Column types will be stored here.
+     * @return             True if the file is a binary columnar file, false otherwise.
+     */
+    bool get_columns( std::vector<std::string> &names_, std::vector<int> &types_ );
+
+    /**
+     * @brief next_block  Retrieves the next block of a binary columnar file without copying.
+     * @param block_      The block will be stored here.
+     * @return            True if there was a block to read, false at the end of file.
+     */
+    bool next_block( mk_block &block_ );
+
+    /**
+     * @brief set_precision  Sets the number of significant digits of written numbers.
+     * @param digits_        Number of digits (default is 6 as with %lg, at most 17), 0 for the
+     *                       shortest representation that reads back exactly.
+     */
+    void set_precision( int digits_ );
+
+    /**
+     * @brief flush  Writes the buffered output in file, in asynchronous mode it waits until all
+     *               output is written.
+     * @return       True if output could be written, false otherwise.
+     */
+    bool flush();
+
     /**
      * @brief put    Writes a text line in file.
      * @param line_  Line to write in file.
@@ -116,6 +654,90 @@ public:
      * @return          Current line of the file.
      */
     std::string get_line();
+
+    /**
+     * @brief get_data  Parses the current line into a vector without allocation if the vector
+     *                  has enough capacity.
+     * @param data_     Vector to store the columns in, it is cleared first.
+     * @return          True if there was a line to read, false at the end of file.
+     */
+    bool get_data( std::vector<double> &data_ );
+
+    /**
+     * @brief parse_token  Parses a field of a line as a token (fields are separated by spaces,
+     *                     tabs and optionally by a separator character).
+     * @param pos_         Current position in the line, it is moved past the field on success.
+     * @param end_         End of the line.
+     * @param token_       The token will be stored here.
+     * @param separator_   Extra separator besides blanks, e.g., ',' (' ' for none).
+     * @return             True if there was a field, false otherwise.
+     */
+    static bool parse_token( const char *&pos_, const char *end_, mk_line &token_,
+                             char separator_ = ' ' );
+
+    /**
+     * @brief parse_int   Parses a field of a line as an integer.
+     * @param pos_        Current position in the line, it is moved past the field on success.
+     * @param end_        End of the line.
+     * @param value_      The value will be stored here.
+     * @param separator_  Extra separator besides blanks.
+     * @return            True if the field is a valid integer, false otherwise.
+     */
+    static bool parse_int( const char *&pos_, const char *end_, int &value_,
+                           char separator_ = ' ' );
+
+    /**
+     * @brief parse_ulong  Parses a field of a line as an unsigned long.
+     * @param pos_         Current position in the line, it is moved past the field on success.
+     * @param end_         End of the line.
+     * @param value_       The value will be stored here.
+     * @param separator_   Extra separator besides blanks.
+     * @return             True if the field is a valid unsigned long, false otherwise.
+     */
+    static bool parse_ulong( const char *&pos_, const char *end_, unsigned long &value_,
+                             char separator_ = ' ' );
+
+    /**
+     * @brief parse_double  Parses a field of a line as a double (exactly rounded).
+     * @param pos_          Current position in the line, it is moved past the field on success.
+     * @param end_          End of the line.
+     * @param value_        The value will be stored here.
+     * @param separator_    Extra separator besides blanks.
+     * @return              True if the field is a valid double, false otherwise.
+     */
+    static bool parse_double( const char *&pos_, const char *end_, double &value_,
+                              char separator_ = ' ' );
+
+    /**
+     * @brief start_chunks  Starts reading the rest of the file in chunks of whole lines. In mapped
+     *                      mode chunks are parsed in parallel and handed over in file order.
+     * @param types_        Column types (ColumnType), further columns are ignored.
+     * @param required_     Number of leading columns a valid record must have.
+     * @param separator_    Extra separator besides blanks, e.g., ',' (' ' for none).
+     * @param numThreads_   Number of worker threads (0 for the number of cores).
+     * @return              True if reading could be started, false otherwise.
+     */
+    bool start_chunks( const std::vector<int> &types_, int required_, char separator_ = ' ',
+                       int numThreads_ = 0 );
+
+    /**
+     * @brief next_chunk  Retrieves the next chunk in file order.
+     * @param chunk_      The chunk will be stored here.
+     * @return            True if there was a chunk to read, false at the end of file.
+     */
+    bool next_chunk( mk_chunk &chunk_ );
+
+    /**
+     * @brief stop_chunks  Stops chunked reading and joins the worker threads.
+     */
+    void stop_chunks();
+
+    /**
+     * @brief next_line  Retrieves the current line without copying in mapped mode.
+     * @param line_      The line (without line break) will be stored here.
+     * @return           True if there was a line to read, false at the end of file.
+     */
+    bool next_line( mk_line &line_ );
 };
 
 }
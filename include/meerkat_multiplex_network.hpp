@@ -0,0 +1,201 @@
+/* meerkat multiplex network.
+ *
+ * A class for storing several temporal network layers over the same set of nodes.
+ *
+ * Copyright (c) 2016, Enys Mones.
+ */
+
+#ifndef MEERKAT_MULTIPLEX_NETWORK_HPP
+#define MEERKAT_MULTIPLEX_NETWORK_HPP
+
+#include "stdlib.h"
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "limits.h"
+#include "meerkat_file_manager.hpp"
+#include "meerkat_logger.hpp"
+#include "meerkat_temporal_network.hpp"
+
+namespace meerkat {
+
+class mk_multiplex_network
+{
+private:
+    /********************
+     * Member variables *
+     ********************/
+    std::vector<mk_temporal_network*> _layers;      // Vector containing pointers to the layers.
+    mk_temporal_network::__labels _labels;          // Node label table shared by the layers.
+    bool _compact;                                  // Whether layers use compact intervals.
+    bool _directed;                                 // Whether layers are directed.
+    mk_logger _log;                                 // Internal logger class for log messages.
+
+
+    /********************
+     * Internal methods *
+     ********************/
+    /**
+     * @brief _is_node_id_valid  Checks if a given node id is valid.
+     * @param nodeId_            Node id to check.
+     * @return                   True if node id is valid, false otherwise.
+     */
+    bool _is_node_id_valid( int nodeId_ ) const;
+
+
+public:
+    /***************************
+     * Constructor, destructor *
+     ***************************/
+    /**
+     * @brief mk_multiplex_network  Constructor.
+     */
+    mk_multiplex_network();
+
+    /**
+     * @brief ~mk_multiplex_network  Destructor.
+     */
+    ~mk_multiplex_network();
+
+
+    /***************************
+     * Structure manipulations *
+     ***************************/
+    /**
+     * @brief set_compact  Sets the storage mode of the activation intervals of the layers.
+     * @param compact_     If true, intervals are stored in compact mode.
+     * @note               Has effect on the subsequent calls of create().
+     */
+    void set_compact( bool compact_ );
+
+    /**
+     * @brief set_directed  Sets whether edges of the layers are directed.
+     * @param directed_     If true, edges are directed.
+     * @note                Has effect on the subsequent calls of create().
+     */
+    void set_directed( bool directed_ );
+
+    /**
+     * @brief create        Creates the multiplex network from temporal edge lists.
+     *                      Layers share the same node labels and vector ids, and are aligned to
+     *                      a common time frame: from the first to the last timestamp of all
+     *                      layers, with the smallest duration as time window. Each file is
+     *                      read once, the contacts of all layers are kept in memory until the
+     *                      common frame is known and the edges are built.
+     * @param filenames_    Files containing the temporal edges of each layer in the following
+     *                      CSV structure: node1 node2 time duration [attribute1 ...]
+     *                      Columns are separated by blanks, or by commas if the header has any.
+     * @param reverseTime_  If true, layers are read in reversed time.
+     * @return              True if all layers could be created, false otherwise.
+     */
+    bool create( const std::vector<std::string> &filenames_,
+                 bool reverseTime_ = false );
+
+    /**
+     * @brief destroy  Destroys the multiplex network.
+     * @return         True if network could be destroyed and memory was freed, false otherwise.
+     */
+    bool destroy();
+
+
+    /*****************
+     * Local queries *
+     *****************/
+    /**
+     * @brief layer     Returns a constant pointer to a layer.
+     * @param layerId_  Id of the layer.
+     * @return          Constant pointer to the layer if layer id is valid, NULL otherwise.
+     */
+    const mk_temporal_network* layer( int layerId_ ) const;
+
+    /**
+     * @brief label    Returns a constant pointer to the label of a given node.
+     * @param nodeId_  Vector id of the node.
+     * @return         Constant pointer to the label of the node if vector id is valid,
+     *                 NULL pointer otherwise.
+     */
+    const std::string* label( int nodeId_ ) const;
+
+    /**
+     * @brief node_id  Returns the vector id for a given label.
+     * @param label_   Label of the node to query.
+     * @return         Vector id of the node (same in all layers) if label is valid, -1
+     *                 otherwise.
+     */
+    int node_id( std::string label_ ) const;
+
+    /**
+     * @brief active_degree  Returns the number of active neighbors of a node over all layers.
+     * @param nodeId_        Vector id of the node.
+     * @return               Sum of active degrees in the layers.
+     */
+    int active_degree( int nodeId_ ) const;
+
+    /**
+     * @brief active_neighbor  Returns the vector id of an active neighbor of a node, with the
+     *                         active neighbors of the layers listed one after the other.
+     * @param nodeId_          Vector id of the node.
+     * @param neighborId_      Neighbor id of the neighbor to query.
+     * @param layerId_         If not NULL, the layer of the neighbor is stored here.
+     * @return                 Vector id of the active neighbor if both the node and the
+     *                         neighbor exist, -1 otherwise.
+     */
+    int active_neighbor( int nodeId_, int neighborId_, int *layerId_ = NULL ) const;
+
+    /**
+     * @brief active_neighbors  Queries the distinct active neighbors of a node in any layer.
+     * @param nodeId_           Vector id of the node.
+     * @param neighbors_        Vector ids of the neighbors will be stored here.
+     */
+    void active_neighbors( int nodeId_, std::vector<int> &neighbors_ ) const;
+
+
+    /******************
+     * Global queries *
+     ******************/
+    /**
+     * @brief layers  Returns the number of layers.
+     * @return        Number of layers.
+     */
+    int layers() const;
+
+    /**
+     * @brief order  Returns the number of nodes.
+     * @return       Number of nodes.
+     */
+    int order() const;
+
+    /**
+     * @brief time  Returns current time.
+     * @return      Current time.
+     */
+    int time() const;
+
+    /**
+     * @brief maxTime  Returns max time.
+     * @return         Max time.
+     */
+    int maxTime() const;
+
+    /**
+     * @brief time_window  Returns the window size.
+     * @return             Time window size.
+     */
+    int time_window() const;
+
+    /**
+     * @brief set_clock  Sets clock time of all layers.
+     * @param time_      Initial time to set the clock to.
+     */
+    void set_clock( const int time_ );
+
+    /**
+     * @brief update_clock  Updates clock of all layers by one time step.
+     */
+    void update_clock();
+};
+
+}
+
+#endif // MEERKAT_MULTIPLEX_NETWORK_HPP
@@ -11,9 +11,17 @@
 #include "stdlib.h"
 #include "stdio.h"
 #include "math.h"
+#include "string.h"
 #include "time.h"
 #include <inttypes.h>
 #include <vector>
+#include <random>
+#include <iterator>
+#include <unordered_set>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MEERKAT_RANDOM_GENERATOR_AVX2
+#endif
 
 namespace meerkat {
 
@@ -21,19 +29,96 @@ namespace meerkat {
 class mk_random_generator
 {
 public:
+    /** Enums */
+    enum Engine {MotherOfAll, Xoshiro256, Pcg64, Philox};   // Pseudo random engines.
+
     /**
-     * @brief The mk_alias_table struct  Encapsulates variables for the alias table method.
+     * @brief The mk_alias_table struct  Encapsulates variables for the alias table method. Tables
+     *                                   are independent of the generator, any number of them can
+     *                                   be sampled with sample_alias_table( table ).
      */
     struct mk_alias_table
     {
+        /**
+         * @brief The mk_alias_cell struct  Column of the table.
+         */
+        struct mk_alias_cell
+        {
+            uint32_t _threshold;        // Column is kept if the coin is below the threshold
+                                        // (probability scaled by 2^32, rounded down).
+            int _alias;                 // Alias (the column itself if it is full).
+        };
+
         bool _isTableSet;               // Is the table properly set up?
         int _n;                         // Size of the table.
-        std::vector<double> _prob;      // Probabilities to use.
-        std::vector<int> _alias;        // Aliases.
+        std::vector<mk_alias_cell> _cells;  // Columns.
+        std::vector<double> _p;         // Scaled weights (scratch, reused by setup).
+        std::vector<int> _work;         // Small and large worklists (scratch, reused by setup).
+
+        mk_alias_table();
+
+        /**
+         * @brief setup     Sets up the table in O(n) time, without allocation if the table was
+         *                  already set up with at least as many weights.
+         * @param weights_  Weights to use for the table.
+         */
+        void setup( const std::vector<double> &weights_ );
+
+        /**
+         * @brief clear  Clears the table.
+         */
+        void clear();
     };
 
     /**
-     * @brief mk_random_generator  Empty constructor, initializes seed.
+     * @brief The mk_dynamic_table struct  Weights stored in a binary sum tree for sampling with
+     *                                     weights that change, e.g., event rates in a Gillespie
+     *                                     simulation. Updates and samples take O(log n) time.
+     */
+    struct mk_dynamic_table
+    {
+        int _n;                         // Number of weights.
+        int _leaves;                    // Number of leaves (power of two).
+        std::vector<double> _tree;      // Sums of subtrees, root at 1, leaf i at _leaves+i.
+
+        mk_dynamic_table();
+
+        /**
+         * @brief setup    Sets all weights in O(n) time.
+         * @param weights_ Weights to use for the table, non-negative.
+         */
+        void setup( const std::vector<double> &weights_ );
+
+        /**
+         * @brief update   Changes a single weight.
+         * @param i_       Index of the weight.
+         * @param weight_  New weight, non-negative.
+         */
+        void update( int i_, double weight_ );
+
+        /**
+         * @brief weight  Returns a weight.
+         * @param i_      Index of the weight.
+         * @return        The weight.
+         */
+        double weight( int i_ ) const;
+
+        /**
+         * @brief total  Returns the sum of weights.
+         * @return       Sum of weights.
+         */
+        double total() const;
+
+        /**
+         * @brief size  Returns the number of weights.
+         * @return      Number of weights.
+         */
+        int size() const;
+    };
+
+    /**
+     * @brief mk_random_generator  Empty constructor, initializes seed from the system entropy
+     *                             source and the current time.
      */
     mk_random_generator();
 
@@ -43,12 +128,96 @@ public:
      */
     mk_random_generator( int seed_ );
 
+    /**
+     * @brief mk_random_generator  Constructor with seed and engine given.
+     * @param seed_                Seed of the random generator.
+     * @param engine_              Pseudo random engine to use.
+     */
+    mk_random_generator( int seed_, Engine engine_ );
+
+    /**
+     * @brief mk_random_generator  Constructor with master seed, stream and engine given.
+     * @param seed_                Master seed.
+     * @param stream_              Stream id (see init_stream()).
+     * @param engine_              Pseudo random engine to use.
+     */
+    mk_random_generator( uint64_t seed_, uint64_t stream_, Engine engine_ );
+
     /**
      * @brief init   Sets seed.
      * @param _seed  Seed to set.
      */
     void init( int _seed );
 
+    /**
+     * @brief init_stream  Sets a 64-bit master seed and selects one of its streams.
+     *                     Xoshiro256 streams are 2^128 steps apart (jumps), Pcg64 streams use
+     *                     distinct increments, so streams of the same seed never overlap.
+     *                     MotherOfAll streams are derived by hashing without such guarantee.
+     *                     Giving stream i to worker thread i makes parallel runs reproducible.
+     *                     Seeding takes one jump per stream id (except for Philox), use
+     *                     create_streams() for many streams.
+     * @param seed_        Master seed.
+     * @param stream_      Stream id.
+     */
+    void init_stream( uint64_t seed_, uint64_t stream_ );
+
+    /**
+     * @brief create_streams  Creates generators for consecutive streams of a master seed.
+     * @param seed_           Master seed.
+     * @param numStreams_     Number of streams (generators) to create.
+     * @param engine_         Pseudo random engine to use.
+     * @param streams_        Generators will be stored here, the i-th one with stream i.
+     */
+    static void create_streams( uint64_t seed_, int numStreams_, Engine engine_,
+                                std::vector<mk_random_generator> &streams_ );
+
+    /**
+     * @brief set_counter  Sets the counter of the Philox engine. Numbers drawn after setting the
+     *                     counter depend only on the seed, stream and the counter, so any thread
+     *                     can reproduce the numbers of an event, e.g., keyed by (replica, node,
+     *                     time step), without sharing generator state.
+     * @param a_           First counter word (e.g., replica).
+     * @param b_           Second counter word (e.g., node).
+     * @param c_           Third counter word (e.g., time step).
+     * @note               Has no effect for the other engines.
+     */
+    void set_counter( uint32_t a_, uint32_t b_, uint32_t c_ );
+
+    /**
+     * @brief jump  Advances the engine by 2^128 (Xoshiro256) or 2^64 (Pcg64) steps.
+     * @note        Not supported by the MotherOfAll and Philox engines.
+     */
+    void jump();
+
+    /**
+     * @brief long_jump  Advances the engine by 2^192 (Xoshiro256) or 2^96 (Pcg64) steps.
+     * @note             Not supported by the MotherOfAll and Philox engines.
+     */
+    void long_jump();
+
+    /**
+     * @brief set_engine  Selects the pseudo random engine and re-initializes it with the
+     *                    current seed.
+     * @param engine_     Engine to use: MotherOfAll (32 bits per step), Xoshiro256
+     *                    (xoshiro256**), Pcg64 (PCG XSL RR 128/64) or Philox (counter-based
+     *                    Philox4x32-10, see set_counter()). The 64-bit engines are seeded
+     *                    through SplitMix64.
+     */
+    void set_engine( Engine engine_ );
+
+    /**
+     * @brief engine  Returns the selected engine.
+     * @return        Pseudo random engine in use.
+     */
+    Engine engine() const;
+
+    /**
+     * @brief bits64  Generates 64 random bits.
+     * @return        The generated bits.
+     */
+    uint64_t bits64();
+
     /**
      * @brief double_uniform  Generates a uniformly distributed double.
      * @param min_            Minimum value.
@@ -71,15 +240,56 @@ public:
      * @param mu_            Distribution mean.
      * @param sigma_         Distribution standard deviation.
      * @return               The generated double.
+     * @note                 Uses the ziggurat method with 128 layers, one 64-bit draw per
+     *                       sample in about 99% of the cases.
      */
     double double_normal( double mu_, double sigma_ );
 
+    /**
+     * @brief double_exponential  Generates an exponentially distributed double.
+     * @param lambda_             Rate of the distribution.
+     * @return                    The generated double.
+     * @note                      Uses the ziggurat method with 256 layers.
+     */
+    double double_exponential( double lambda_ );
+
     /**
      * @brief double_shuffle  Shuffles a vetor of doubles.
      * @param vec_            Vector to shuffle.
      */
     void double_shuffle( std::vector<double> &vec_ );
 
+    /**
+     * @brief shuffle  Shuffles a range uniformly (Fisher-Yates), one bounded draw per element.
+     * @param first_   Random access iterator to the first element.
+     * @param last_    Random access iterator past the last element.
+     */
+    template <class RandomIt>
+    void shuffle( RandomIt first_, RandomIt last_ );
+
+    /**
+     * @brief partial_shuffle  Moves a uniformly chosen sample of k elements in random order to the
+     *                         front of the range, the rest stays in the back in arbitrary order.
+     * @param first_           Random access iterator to the first element.
+     * @param last_            Random access iterator past the last element.
+     * @param k_               Number of elements to choose.
+     * @note                   Takes O(k) time, so it can be used to draw without replacement.
+     */
+    template <class RandomIt>
+    void partial_shuffle( RandomIt first_, RandomIt last_, int k_ );
+
+    /**
+     * @brief reservoir_sample  Draws k elements uniformly without replacement from a range of
+     *                          unknown length (reservoir algorithm L).
+     * @param first_            Input iterator to the first element.
+     * @param last_             Input iterator past the last element.
+     * @param k_                Number of elements to draw.
+     * @param sample_           Sample will be stored here, in arbitrary order. If the range is
+     *                          shorter than k, it contains all elements.
+     */
+    template <class InputIt, class T>
+    void reservoir_sample( InputIt first_, InputIt last_, int k_, std::vector<T> &sample_ );
+
     /**
      * @brief integer_uniform  Generates a uniformly distributed integer.
      * @param min_             Minimum value.
@@ -92,9 +302,31 @@ public:
      * @brief integer_poisson  Generates an integer with Poisson distribution.
      * @param lambda_          The parameter of the distribution.
      * @return                 The generated integer.
+     * @note                   Uses multiplication of uniforms for lambda < 10 and the PTRS
+     *                         transformed rejection method (Hormann) with O(1) expected cost
+     *                         above.
      */
     int integer_poisson( double lambda_ );
 
+    /**
+     * @brief integer_binomial  Generates an integer with binomial distribution.
+     * @param n_                Number of trials.
+     * @param p_                Success probability.
+     * @return                  The generated integer.
+     * @note                    Uses inversion for n*min(p, 1-p) < 10 and the BTRS transformed
+     *                          rejection method (Hormann) with O(1) expected cost above.
+     */
+    int integer_binomial( int n_, double p_ );
+
+    /**
+     * @brief integer_geometric  Generates an integer with geometric distribution, i.e., the number
+     *                           of failures before the first success.
+     * @param p_                 Success probability.
+     * @return                   The generated integer, INT_MAX (with a warning) if p_ is not
+     *                           positive.
+     */
+    int integer_geometric( double p_ );
+
     /**
      * @brief integer_bounded_pareto  Generates an integer following the bounded Pareto distribution.
      * @param min_                    Minimum value.
@@ -118,6 +350,15 @@ public:
      */
     void integer_shuffle( std::vector<int> &vec_ );
 
+    /**
+     * @brief integer_sample  Draws k different integers uniformly from [0, n) (Floyd's
+     *                        algorithm), in O(k) time and space.
+     * @param n_              Size of the population.
+     * @param k_              Number of integers to draw, at most n.
+     * @param sample_         Sample will be stored here, in arbitrary order.
+     */
+    void integer_sample( int n_, int k_, std::vector<int> &sample_ );
+
     /**
      * @brief setup_alias_table  Sets up alias table.
      * @param weights_           Weights to use for the table.
@@ -130,17 +371,252 @@ public:
      */
     int sample_alias_table();
 
+    /**
+     * @brief sample_alias_table  Generates a random integer from the given table, the column and
+     *                            the coin are taken from a single 64-bit draw.
+     * @param table_              Table to sample from.
+     * @note                      The coin is compared with a 32-bit threshold, so the
+     *                            probability of keeping a column is rounded down to a multiple
+     *                            of 2^-32. Sampled sequences are not identical to those of the
+     *                            former two-draw method (integer_uniform() and double_uniform()).
+     * @return                    The generated integer.
+     */
+    int sample_alias_table( const mk_alias_table &table_ );
+
     /**
      * @brief clear_alias_table  Clears alias table.
      */
     void clear_alias_table();
 
+    /**
+     * @brief sample_dynamic_table  Generates a random integer from a dynamic table, with
+     *                              probability proportional to its weight.
+     * @param table_                Table to sample from.
+     * @return                      The generated integer.
+     */
+    int sample_dynamic_table( const mk_dynamic_table &table_ );
+
+    /**
+     * @brief fill_uniform  Fills an array with uniformly distributed doubles.
+     * @param data_         Array to fill.
+     * @param n_            Number of elements to generate.
+     * @param min_          Minimum value.
+     * @param max_          Maximum value.
+     * @note                Bulk methods draw from a separate 4-lane xoshiro256** generator,
+     *                      stepped with AVX2 if the CPU supports it. The lanes produce the same
+     *                      stream regardless of the path, independently of the selected engine.
+     *                      With the Philox engine, bulk methods draw from the counter stream in
+     *                      batches of blocks instead, consuming the same bits as single draws.
+     */
+    void fill_uniform( double *data_, int n_, double min_, double max_ );
+
+    /**
+     * @brief fill_integer_uniform  Fills an array with uniformly distributed integers.
+     * @param data_                 Array to fill.
+     * @param n_                    Number of elements to generate.
+     * @param min_                  Minimum value.
+     * @param max_                  Maximum value.
+     */
+    void fill_integer_uniform( int *data_, int n_, int min_, int max_ );
+
+    /**
+     * @brief fill_normal  Fills an array with normally distributed doubles.
+     * @param data_        Array to fill.
+     * @param n_           Number of elements to generate.
+     * @param mu_          Distribution mean.
+     * @param sigma_       Distribution standard deviation.
+     */
+    void fill_normal( double *data_, int n_, double mu_, double sigma_ );
+
 private:
+    Engine _engine;               // Selected engine.
+    uint64_t _seed;               // Current (master) seed.
+    uint64_t _stream;             // Current stream.
     uint32_t _x[5];               // Array of integers used by the Mother-of-all method.
+    uint64_t _s[4];               // State of the xoshiro256** engine.
+    uint64_t _pcg[4];             // State (high, low) and increment (high, low) of the PCG64 engine.
+    uint32_t _philox[6];          // Key (2 words) and counter (4 words) of the Philox engine.
+    uint64_t _philoxOut[2];       // Unused output of the current Philox block.
+    int _philoxIndex;             // Index of the next unused output of the Philox block.
+    uint64_t _lanes[16];          // State of the 4-lane xoshiro256** generator of the bulk methods
+                                  // (word-major: _lanes[4*word + lane]).
     mk_alias_table _a;            // Alias table.
-    uint32_t _random_bits();      // Generates random bits.
+    uint32_t _random_bits();      // Generates 32 random bits.
+    uint64_t _random_bits64();    // Generates 64 random bits.
+    double _random_double();      // Generates a double in [0, 1).
+
+    /**
+     * @brief _bounded  Generates an unbiased integer in [0, range) with Lemire's multiply and
+     *                  reject method, a division only happens on rare rejections.
+     * @param range_    Size of the range, positive.
+     * @return          The generated integer.
+     */
+    uint32_t _bounded( uint32_t range_ );
+
+    /**
+     * @brief _splitmix64  Generates the next output of a SplitMix64 sequence (used for seeding).
+     * @param state_       State of the sequence, it is updated.
+     * @return             The generated bits.
+     */
+    static uint64_t _splitmix64( uint64_t &state_ );
+
+    /**
+     * @brief _xoshiro_jump  Advances a xoshiro256** state by 2^128 (jump) or 2^192 (long jump)
+     *                       steps.
+     * @param state_         State to advance.
+     * @param long_          If true, long jump is performed.
+     */
+    static void _xoshiro_jump( uint64_t *state_, bool long_ );
+
+    /**
+     * @brief _pcg_advance  Advances the PCG64 engine.
+     * @param deltaHigh_    High 64 bits of the number of steps.
+     * @param deltaLow_     Low 64 bits of the number of steps.
+     */
+    void _pcg_advance( uint64_t deltaHigh_, uint64_t deltaLow_ );
+
+    /**
+     * @brief _poisson_ptrs  Generates a Poisson integer with the PTRS method.
+     * @param lambda_        The parameter of the distribution, at least 10.
+     * @return               The generated integer.
+     */
+    int _poisson_ptrs( double lambda_ );
+
+    /**
+     * @brief _binomial_inversion  Generates a binomial integer by inversion.
+     * @param n_                   Number of trials.
+     * @param p_                   Success probability, at most 0.5.
+     * @return                     The generated integer.
+     */
+    int _binomial_inversion( int n_, double p_ );
+
+    /**
+     * @brief _binomial_btrs  Generates a binomial integer with the BTRS method.
+     * @param n_              Number of trials.
+     * @param p_              Success probability, at most 0.5 with n*p at least 10.
+     * @return                The generated integer.
+     */
+    int _binomial_btrs( int n_, double p_ );
+
+    /**
+     * @brief _philox_block  Computes a Philox4x32-10 block.
+     * @param counter_       Counter (4 words).
+     * @param key_           Key (2 words).
+     * @param out_           Output (4 words) will be stored here.
+     */
+    static void _philox_block( const uint32_t *counter_, const uint32_t *key_, uint32_t *out_ );
+
+    /**
+     * @brief _philox_bits  Generates random bits with the Philox engine, the same as the given
+     *                      number of single draws. Blocks of consecutive counters are computed
+     *                      in batches of 16, with AVX2 if the CPU supports it.
+     * @param data_         Array to fill.
+     * @param n_            Number of 64-bit elements to generate.
+     */
+    void _philox_bits( uint64_t *data_, int n_ );
+
+    /**
+     * @brief _philox_batch_scalar  Computes 16 Philox blocks from consecutive counters.
+     * @param philox_               Key and counter of the first block.
+     * @param out_                  Output (32 elements) will be stored here.
+     */
+    static void _philox_batch_scalar( const uint32_t *philox_, uint64_t *out_ );
+
+#ifdef MEERKAT_RANDOM_GENERATOR_AVX2
+    /**
+     * @brief _philox_batch_avx2  AVX2 implementation of _philox_batch_scalar.
+     */
+    __attribute__((target("avx2"))) static void _philox_batch_avx2( const uint32_t *philox_, uint64_t *out_ );
+#endif
+
+    /**
+     * @brief _bulk_bits  Generates random bits for the bulk methods.
+     * @param data_       Array to fill, must have space for a multiple of 4 elements.
+     * @param n_          Number of elements to generate.
+     */
+    void _bulk_bits( uint64_t *data_, int n_ );
+
+    /**
+     * @brief _seed_engine  Initializes the state of the engine from the seed and stream.
+     */
+    void _seed_engine();
+
+    /**
+     * @brief _seed_lanes  Initializes the lanes of the bulk generator from the seed and stream,
+     *                     takes one long jump per stream id (not used by Philox).
+     */
+    void _seed_lanes();
+
+    /**
+     * @brief _lane_bits  Generates random bits with the bulk generator, one step of all lanes
+     *                    for each block of 4 elements.
+     * @param data_       Array to fill.
+     * @param blocks_     Number of blocks to generate.
+     */
+    void _lane_bits( uint64_t *data_, int blocks_ );
+
+    /**
+     * @brief _lane_bits_scalar  Portable implementation of _lane_bits.
+     */
+    void _lane_bits_scalar( uint64_t *data_, int blocks_ );
+
+#ifdef MEERKAT_RANDOM_GENERATOR_AVX2
+    /**
+     * @brief _lane_bits_avx2  AVX2 implementation of _lane_bits.
+     */
+    __attribute__((target("avx2"))) void _lane_bits_avx2( uint64_t *data_, int blocks_ );
+#endif
 };
 
+template <class RandomIt>
+void mk_random_generator::shuffle( RandomIt first_, RandomIt last_ )
+{
+    typename std::iterator_traits<RandomIt>::difference_type n = last_ - first_;
+    for(uint32_t i=(uint32_t)n; i>1; i--)
+        std::iter_swap( first_ + (i-1), first_ + _bounded(i) );
+}
+
+template <class RandomIt>
+void mk_random_generator::partial_shuffle( RandomIt first_, RandomIt last_, int k_ )
+{
+    uint32_t n = (uint32_t)(last_ - first_);
+    uint32_t k = k_ < (int)n ? (uint32_t)k_ : n;
+    for(uint32_t i=0; i<k && i+1<n; i++)
+        std::iter_swap( first_ + i, first_ + (i + _bounded(n-i)) );
+}
+
+template <class InputIt, class T>
+void mk_random_generator::reservoir_sample( InputIt first_, InputIt last_, int k_,
+                                            std::vector<T> &sample_ )
+{
+    sample_.clear();
+    if( k_ <= 0 )
+        return;
+
+    // fill reservoir
+    while( first_ != last_ && (int)sample_.size() < k_ )
+    {
+        sample_.push_back( *first_ );
+        ++first_;
+    }
+
+    // skip geometrically many elements between replacements, u in (0, 1] to avoid log(0)
+    double w = exp( log((double)((_random_bits64() >> 11) + 1) * (1.0/9007199254740992.0)) / k_ );
+    double skip;
+    while( first_ != last_ )
+    {
+        skip = floor( log((double)((_random_bits64() >> 11) + 1) * (1.0/9007199254740992.0))
+                      / log1p(-w) );
+        for(; skip > 0.0 && first_ != last_; skip -= 1.0)
+            ++first_;
+        if( first_ == last_ )
+            break;
+        sample_[_bounded( (uint32_t)k_ )] = *first_;
+        ++first_;
+        w *= exp( log((double)((_random_bits64() >> 11) + 1) * (1.0/9007199254740992.0)) / k_ );
+    }
+}
+
 }
 
 #endif // MEERKAT_RANDOM_GENERATOR_HPP
@@ -0,0 +1,221 @@
+/* meerkat temporal gillespie.
+ *
+ * Rejection-free continuous-time simulation of compartmental processes on a temporal network
+ * (temporal Gillespie algorithm). Nodes are in one of a given number of states and change
+ * state either spontaneously or through active contacts with nodes in a given state, e.g.,
+ * SIR: add_contact_transition( S, I, I, beta ) and add_transition( I, R, mu ).
+ *
+ * Copyright (c) 2016, Enys Mones.
+ */
+
+#ifndef MEERKAT_TEMPORAL_GILLESPIE_HPP
+#define MEERKAT_TEMPORAL_GILLESPIE_HPP
+
+#include "stdlib.h"
+#include "stdio.h"
+#include <vector>
+#include "meerkat_logger.hpp"
+#include "meerkat_random_generator.hpp"
+#include "meerkat_temporal_network.hpp"
+
+namespace meerkat {
+
+class mk_temporal_gillespie
+{
+private:
+    /***********************
+     * Internal structures *
+     ***********************/
+    /**
+     * @brief The transition struct:  A state transition of a node.
+     */
+    struct __transition {
+        int _from;          // State of the node before the transition.
+        int _to;            // State of the node after the transition.
+        int _source;        // State of the active in-neighbors inducing the transition (-1 if
+                            // spontaneous).
+        double _rate;       // Rate per unit time (per active in-neighbor in _source state).
+    };
+
+
+    /********************
+     * Member variables *
+     ********************/
+    mk_temporal_network *_network;                  // Network the process runs on.
+    mk_random_generator *_generator;                // Random generator.
+    int _numStates;                                 // Number of node states.
+    std::vector<__transition> _transitions;         // Transitions.
+    std::vector<std::vector<int> > _byState;        // Transition ids for each starting state.
+    std::vector<int> _states;                       // State of each node.
+    std::vector<int> _population;                   // Number of nodes in each state.
+    std::vector<int> _counts;                       // Number of active in-neighbors in each
+                                                    // state for each node (node-major).
+    mk_random_generator::mk_dynamic_table _rates;   // Total transition rate of each node.
+    bool _isReady;                                  // Whether rates are set up by init().
+    double _tau;                                    // Remaining integrated rate until the next
+                                                    // event (exponential with unit mean).
+    int _start;                                     // Time index of init().
+    int _steps;                                     // Number of time steps simulated.
+    double _eventTime;                              // Time of the last event.
+    unsigned long _events;                          // Number of events.
+    mk_logger _log;                                 // Internal logger class for log messages.
+
+
+    /********************
+     * Internal methods *
+     ********************/
+    /**
+     * @brief _node_rate  Computes the total transition rate of a node.
+     * @param nodeId_     Node id.
+     * @return            Sum of the rates of all possible transitions.
+     */
+    double _node_rate( int nodeId_ ) const;
+
+    /**
+     * @brief _rebuild  Recounts the states of active in-neighbors and sets up all rates.
+     */
+    void _rebuild();
+
+    /**
+     * @brief _change_state  Changes the state of a node and updates the counts and rates of its
+     *                       active out-neighbors.
+     * @param nodeId_        Node id.
+     * @param state_         New state.
+     */
+    void _change_state( int nodeId_, int state_ );
+
+    /**
+     * @brief _apply_switches  Updates counts and rates for the edges that became active or
+     *                         inactive in the last clock update.
+     */
+    void _apply_switches();
+
+    /**
+     * @brief _fire    Performs a random transition of a node, chosen by the rates.
+     * @param nodeId_  Node id.
+     */
+    void _fire( int nodeId_ );
+
+
+public:
+    /***************************
+     * Constructor, destructor *
+     ***************************/
+    /**
+     * @brief mk_temporal_gillespie  Constructor.
+     * @param network_               Network to run the process on, the clock of the network is
+     *                               driven by the simulation.
+     * @param generator_             Random generator to use.
+     */
+    mk_temporal_gillespie( mk_temporal_network *network_, mk_random_generator *generator_ );
+
+    /**
+     * @brief ~mk_temporal_gillespie  Destructor.
+     */
+    ~mk_temporal_gillespie();
+
+
+    /********************
+     * Model definition *
+     ********************/
+    /**
+     * @brief set_states  Sets the number of node states and removes all transitions. All nodes
+     *                    of the (already created) network are set to state 0.
+     * @param numStates_  Number of states.
+     * @return            True if states could be set, false otherwise.
+     */
+    bool set_states( int numStates_ );
+
+    /**
+     * @brief add_transition  Adds a spontaneous transition.
+     * @param from_           State before the transition.
+     * @param to_             State after the transition.
+     * @param rate_           Rate per unit time.
+     * @return                True if transition could be added, false otherwise.
+     */
+    bool add_transition( int from_, int to_, double rate_ );
+
+    /**
+     * @brief add_contact_transition  Adds a transition induced by active contacts.
+     * @param from_                   State before the transition.
+     * @param to_                     State after the transition.
+     * @param source_                 State of the in-neighbors inducing the transition.
+     * @param rate_                   Rate per unit time per active in-neighbor in source state.
+     * @return                        True if transition could be added, false otherwise.
+     */
+    bool add_contact_transition( int from_, int to_, int source_, double rate_ );
+
+    /**
+     * @brief set_state  Sets the state of a node.
+     * @param nodeId_    Node id.
+     * @param state_     State to set.
+     * @return           True if state could be set, false otherwise.
+     */
+    bool set_state( int nodeId_, int state_ );
+
+
+    /**************
+     * Simulation *
+     **************/
+    /**
+     * @brief init   Sets the clock of the network and sets up all rates.
+     * @param time_  Time index to start at.
+     * @return       True if the simulation could be initialized, false otherwise.
+     */
+    bool init( int time_ );
+
+    /**
+     * @brief run     Simulates a number of time steps. Within a step the active contacts are
+     *                fixed, events are drawn from the total rate, which is maintained
+     *                incrementally as contacts switch and nodes change state.
+     * @param steps_  Number of time steps.
+     * @return        Number of events in the simulated steps.
+     */
+    int run( int steps_ );
+
+
+    /***********
+     * Queries *
+     ***********/
+    /**
+     * @brief state    Returns the state of a node.
+     * @param nodeId_  Node id.
+     * @return         State of the node.
+     */
+    int state( int nodeId_ ) const;
+
+    /**
+     * @brief population  Returns the number of nodes in a state.
+     * @param state_      State.
+     * @return            Number of nodes in the state.
+     */
+    int population( int state_ ) const;
+
+    /**
+     * @brief total_rate  Returns the current total transition rate.
+     * @return            Sum of the rates of all nodes.
+     */
+    double total_rate() const;
+
+    /**
+     * @brief time  Returns the simulated time (start of the next time step).
+     * @return      Simulated time.
+     */
+    double time() const;
+
+    /**
+     * @brief last_event_time  Returns the time of the last event.
+     * @return                 Time of the last event.
+     */
+    double last_event_time() const;
+
+    /**
+     * @brief events  Returns the number of events since init().
+     * @return        Number of events.
+     */
+    unsigned long events() const;
+};
+
+}
+
+#endif // MEERKAT_TEMPORAL_GILLESPIE_HPP
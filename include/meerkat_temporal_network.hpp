@@ -13,20 +13,141 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <queue>
+#include <algorithm>
+#include <thread>
 #include "limits.h"
 #include "meerkat_file_manager.hpp"
 #include "meerkat_logger.hpp"
 
 namespace meerkat {
 
+class mk_multiplex_network;
+class mk_temporal_gillespie;
+
 class mk_temporal_network
 {
+    friend class mk_multiplex_network;
+    friend class mk_temporal_gillespie;
+
 private:
     struct __node;
 
     /***********************
      * Internal structures *
      ***********************/
+    /**
+     * @brief The cursor struct:  Position of an edge in the activation intervals of its
+     *                            activity. Holds the decoded current interval.
+     */
+    struct __cursor {
+        int _index;                     // Index of the current interval.
+        int _offset;                    // Byte offset of the next interval (compact mode).
+        int _base;                      // End time of the previous interval (compact mode).
+        int _start;                     // Start time of the current interval.
+        int _duration;                  // Duration of the current interval, -1 at end of time.
+    };
+
+    /**
+     * @brief The activity struct:  Stores the activation intervals of an edge.
+     *                              The same activity is shared by both directions of the edge.
+     *                              Intervals are kept in a single buffer. In plain mode, it holds
+     *                              (start, duration) pairs. In compact mode, it holds varint
+     *                              encoded (gap, duration) pairs, split in blocks of fixed number
+     *                              of intervals, preceded by a skip pointer to each block but the
+     *                              first for seeking.
+     */
+    struct __activity {
+        /**
+         * @brief The block struct:  Skip pointer to a block of intervals (compact mode).
+         */
+        struct __block {
+            int _offset;                // Byte offset of the first interval of the block.
+            int _base;                  // End time of the interval preceding the block.
+            int _first;                 // Start time of the first interval of the block.
+        };
+
+        static const int _blockSize = 32;       // Number of intervals in a block.
+
+        bool _compact;                          // Whether intervals are compressed.
+        int _length;                            // Total length of time (end of the clock).
+        int _size;                              // Number of intervals.
+        int _total;                             // Total active time.
+        int _end;                               // End time of the last interval.
+        int _offset;                            // Index of the first interval in the attribute
+                                                // columns of the network.
+        std::vector<unsigned char> _data;       // Intervals, (start, duration) pairs in plain
+                                                // mode, skip pointers and encoded intervals in
+                                                // compact mode.
+
+        /**
+         * @brief activity  Constructor of an empty activity.
+         * @param length_   Total length of time.
+         * @param compact_  If true, intervals are stored in compact mode.
+         */
+        __activity( const int length_, const bool compact_ );
+
+        /**
+         * @brief push       Appends an interval.
+         * @param start_     Start time of the interval.
+         * @param duration_  Duration of the interval.
+         * @note             Intervals must be pushed in increasing order of time and must not
+         *                   overlap.
+         */
+        void push( const int start_, const int duration_ );
+
+        /**
+         * @brief shrink  Releases unused capacity after all intervals are pushed. In compact mode,
+         *                it also moves the skip pointers in front of the encoded intervals, the
+         *                activity can be read only afterwards.
+         */
+        void shrink();
+
+        /**
+         * @brief rewind    Moves a cursor to the first interval.
+         * @param cursor_   Cursor to move.
+         */
+        void rewind( __cursor &cursor_ ) const;
+
+        /**
+         * @brief next     Moves a cursor to the next interval.
+         * @param cursor_  Cursor to move.
+         * @note           Past the last interval, cursor points to the end of time.
+         */
+        void next( __cursor &cursor_ ) const;
+
+        /**
+         * @brief seek     Moves a cursor to the first interval starting after a given time.
+         * @param cursor_  Cursor to move.
+         * @param time_    Time to seek.
+         * @return         Remaining active time of the edge at the given time.
+         */
+        int seek( __cursor &cursor_, const int time_ ) const;
+
+        /**
+         * @brief skip     Returns a skip pointer (compact mode).
+         * @param index_   Index of the skip pointer (that of block index_+1).
+         * @return         Copy of the skip pointer.
+         * @note           Buffer is only accessed bytewise, skip pointers and intervals are
+         *                 copied out with memcpy.
+         */
+        __block skip( const int index_ ) const;
+
+        /**
+         * @brief interval   Reads an interval (plain mode).
+         * @param index_     Index of the interval.
+         * @param start_     Start time will be stored here.
+         * @param duration_  Duration will be stored here.
+         */
+        void interval( const int index_, int &start_, int &duration_ ) const;
+
+        /**
+         * @brief bytes  Returns the memory used by the intervals.
+         * @return       Size of interval storage in bytes.
+         */
+        unsigned long bytes() const;
+    };
+
     /**
      * @brief The edge struct:  Encapsulates all edge-related operations.
      *                          Since the dynamics is based on the edge temporality,
@@ -34,22 +155,61 @@ private:
      */
     struct __edge {
         __node *_ptr;                   // Pointer to the neighboring node.
-        int _vectorIndex;               // Current index in the starting times and durations
-                                        // vectors.
+        __activity *_activity;          // Activation intervals of the edge (shared).
+        __cursor _cursor;               // Position of the next appearance.
         int _timeIndex;                 // Current global time.
         int _activeTime;                // Current active time of the edge.
         int _waitingTime;               // Waiting time to the next appearance.
-        std::vector<int> _starts;       // Starting times of the edge.
-        std::vector<int> _durations;    // Durations of the edge in the different appearances.
 
         /**
-         * @brief edge       Constructor of the edge, sets up internal temporal vectors based
-         *                   on an activity pattern.
+         * @brief edge       Constructor of the edge.
          * @param ptr_       Pointer to the neighboring node.
-         * @param activity_  Activity pattern of the edge. An element in the activity_ vector
-         *                   is true if and only if the edge is active at that time index.
+         * @param activity_  Activation intervals of the edge.
          */
-        __edge( __node* ptr_, std::vector<bool> &activity_ );
+        __edge( __node* ptr_, __activity *activity_ );
+    };
+
+    /**
+     * @brief The contact struct:  A single contact read from a temporal edge list.
+     */
+    struct __contact {
+        int _node1;                     // Vector id of the first (source) node.
+        int _node2;                     // Vector id of the second (target) node.
+        unsigned long _time;            // Timestamp of the contact.
+        unsigned long _duration;        // Duration of the contact.
+        int _start;                     // Start time index.
+        int _end;                       // End time index (exclusive).
+        int _row;                       // Row of the contact in the edge list.
+
+        /**
+         * @brief operator <  Orders contacts by node ids and then by time.
+         * @param c_          Contact to compare with.
+         * @return            True if this contact precedes the other one.
+         */
+        bool operator<( const __contact &c_ ) const;
+    };
+
+    /**
+     * @brief The pending struct:  Contacts read from an edge list that are not built into edges
+     *                             yet, with the time frame they span.
+     */
+    struct __pending {
+        std::vector<__contact> _contacts;   // Valid contacts in the order of the rows.
+        std::vector<double> _values;        // Attribute values of the contacts (row-major).
+        int _invalid;                       // Number of invalid rows.
+        unsigned long _start;               // First timestamp.
+        unsigned long _end;                 // Last timestamp (end of the last contact).
+        unsigned long _window;              // Smallest positive duration (1 if there is none).
+    };
+
+    /**
+     * @brief The labels struct:  Node label table, mapping between labels and vector ids.
+     *                            The table can be shared by several networks (layers of a
+     *                            multiplex network).
+     */
+    struct __labels {
+        std::vector<std::string> _labels;         // Labels in the order of vector ids.
+        std::map<std::string, int> _hash;         // Mapping from label to vector id.
     };
 
     /**
@@ -57,16 +217,18 @@ private:
      */
     struct __node {
         int _id;                                  // Vector id of the node in the network.
-        std::string _label;                       // Label of the node.
         std::vector<__edge*> _neighbors;          // Vector of pointers to the incident edges.
-        std::vector<__node*> _activeNeighbors;    // Vector of pointers to the active neighbors.
+        std::vector<__edge*> _activeNeighbors;    // Vector of pointers to the active edges.
+        std::vector<__edge*> _inNeighbors;        // Vector of pointers to the incoming edges
+                                                  // (directed mode only).
+        std::vector<__edge*> _activeInNeighbors;  // Vector of pointers to the active incoming
+                                                  // edges (directed mode only).
 
         /**
          * @brief node    Constructor of the node.
          * @param id_     Vector id in the network.
-         * @param label_  Node label.
          */
-        __node( const int id_, const std::string label_ );
+        __node( const int id_ );
 
         /**
          * @brief add_neighbor  Adds a neighbor.
@@ -75,6 +237,34 @@ private:
          */
         bool add_neighbor( __edge *edge_ );
 
+        /**
+         * @brief add_in_neighbor  Adds an in-neighbor (directed mode only).
+         * @param edge_            Pointer to the edge that contains the in-neighbor's pointer.
+         * @return                 True if in-neighbor could be added, false otherwise.
+         */
+        bool add_in_neighbor( __edge *edge_ );
+
+        /**
+         * @brief set_clock         Sets clock time for a list of edges.
+         * @param edges_            Edges to set.
+         * @param activeNeighbors_  Active edges will be stored here.
+         * @param time_             Start time of the clock to set.
+         */
+        static void set_clock( std::vector<__edge*> &edges_,
+                               std::vector<__edge*> &activeNeighbors_,
+                               const int time_ );
+
+        /**
+         * @brief update_clock      Updates clock time by one step for a list of edges.
+         * @param edges_            Edges to update.
+         * @param activeNeighbors_  Active edges will be stored here.
+         * @param switched_         If not NULL, edges that became active or inactive are
+         *                          appended here.
+         */
+        static void update_clock( std::vector<__edge*> &edges_,
+                                  std::vector<__edge*> &activeNeighbors_,
+                                  std::vector<__edge*> *switched_ = NULL );
+
         /**
          * @brief set_clock  Sets clock time.
          * @param time_      Start time of the clock to set.
@@ -95,10 +285,27 @@ private:
      * Member variables *
      ********************/
     std::vector<__node*> _nodes;                // Vector containing pointers to the nodes.
-    std::map<std::string, int> _labelsHash;     // Mapping from label to id in the node vector.
+    std::vector<__activity*> _activities;       // Vector containing pointers to the activities.
+    __labels *_labels;                          // Node label table.
+    bool _sharedLabels;                         // Whether the label table is shared.
     int _currentTime;                           // Current time index.
     int _maxTime;                               // Maximum time index.
     int _timeWindow;                            // Time window (size of a single step).
+    bool _compact;                              // Whether intervals are stored in compact mode.
+    bool _directed;                             // Whether edges are directed.
+    int _numIntervals;                          // Total number of intervals.
+    std::vector<std::string> _attributeNames;   // Names of the contact attributes.
+    std::vector<std::vector<double> > _attributes;  // Attribute columns, aligned with intervals.
+    bool _isFrameSet;                           // Whether the time frame is fixed.
+    unsigned long _frameStart;                  // Fixed start timestamp.
+    unsigned long _frameEnd;                    // Fixed end timestamp.
+    unsigned long _frameWindow;                 // Fixed time window.
+    __pending _pending;                         // Contacts read but not built yet.
+    bool _trackSwitches;                        // Whether update_clock() records switches.
+    std::vector<std::pair<int, __edge*> > _switches;    // Incoming edges (with the receiving
+                                                        // node) that became active or inactive
+                                                        // in the last update_clock().
+    std::vector<__edge*> _switched;             // Switched edges of a single node (buffer).
     mk_logger _log;                             // Internal logger class for log messages.
 
 
@@ -121,6 +328,46 @@ private:
      */
     bool _is_there_edge( const int node1Id_, const int node2Id_ ) const;
 
+    /**
+     * @brief _in_edges  Returns the incoming edges of a node.
+     * @param nodeId_    Vector id of the node.
+     * @return           Incoming edges in directed mode, incident edges otherwise.
+     * @note             This method does not check against vector id validity.
+     */
+    const std::vector<__edge*> &_in_edges( const int nodeId_ ) const;
+
+    /**
+     * @brief _active_in_neighbors  Returns the active incoming edges of a node.
+     * @param nodeId_               Vector id of the node.
+     * @return                      Active incoming edges in directed mode, active edges
+     *                              otherwise.
+     * @note                        This method does not check against vector id validity.
+     */
+    const std::vector<__edge*> &_active_in_neighbors( const int nodeId_ ) const;
+
+    /**
+     * @brief _share_labels  Replaces the own label table with a shared one.
+     * @param labels_        Label table to share, owned by the caller.
+     * @note                 Must be called before the network is created.
+     */
+    void _share_labels( __labels *labels_ );
+
+    /**
+     * @brief _sync_nodes  Adds nodes for all labels of the label table that have no node yet.
+     */
+    void _sync_nodes();
+
+    /**
+     * @brief _set_frame       Fixes the time frame used by create() instead of the one found in
+     *                         the edge list.
+     * @param startTimestamp_  Start timestamp.
+     * @param endTimestamp_    End timestamp.
+     * @param timeWindow_      Time window.
+     */
+    void _set_frame( unsigned long startTimestamp_,
+                     unsigned long endTimestamp_,
+                     unsigned long timeWindow_ );
+
     /**
      * @brief add_node  Adds a node to the network.
      * @param label_    Label of the node to add.
@@ -129,13 +376,61 @@ private:
     bool _add_node( const std::string label_ );
 
     /**
-     * @brief _add_edge  Adds an edge to the network.
-     * @param node1Id_   Vector id of the first terminal node of the edge.
-     * @param node2Id_   Second terminal node of the edge.
-     * @param activity_  Activity pattern of the edge to add.
-     * @return           True if edge could be added, false otherwise.
+     * @brief _add_edge   Adds an edge to the network.
+     * @param node1Id_    Vector id of the first terminal node of the edge.
+     * @param node2Id_    Second terminal node of the edge.
+     * @param activity_   Activation intervals of the edge, the network takes ownership.
+     * @return            True if edge could be added, false otherwise (activity is deleted).
+     * @note              No self-edges are allowed. Multiple edges are not checked, contacts
+     *                    are merged per node pair beforehand.
+     */
+    bool _add_edge( const int node1Id_, const int node2Id_, __activity *activity_ );
+
+    /**
+     * @brief _set_attribute_names  Sets the attribute names from the header of an edge list.
+     * @param header_               Header line, columns after the fourth one are attributes.
+     * @param separator_            Extra separator besides blanks.
+     */
+    void _set_attribute_names( const std::string &header_, char separator_ );
+
+    /**
+     * @brief _sort_contacts  Sorts contacts by node ids and time. Large inputs are sorted in
+     *                        parallel chunks which are then merged.
+     * @param contacts_       Contacts to sort.
+     */
+    static void _sort_contacts( std::vector<__contact> &contacts_ );
+
+    /**
+     * @brief _read_contacts  Reads the contacts of a temporal edge list and determines their time
+     *                        frame, without building the edges (see _build_edges()).
+     * @param fm_             File manager with the edge list open for read.
+     * @param addNodes_       If true, nodes are added for new labels, otherwise rows with unknown
+     *                        labels are dropped.
+     * @return                True if there is any valid contact, false otherwise.
      */
-    bool _add_edge( const int node1Id_, const int node2Id_, std::vector<bool> &activity_ );
+    bool _read_contacts( mk_file_manager &fm_, bool addNodes_ );
+
+    /**
+     * @brief _build_edges   Builds the edges from the contacts read by _read_contacts(), using
+     *                       the fixed time frame if it is set, and releases the contacts.
+     * @param reverseTime_   If true, network is built in reversed time.
+     * @return               True if edges could be built, false otherwise.
+     */
+    bool _build_edges( bool reverseTime_ );
+
+    /**
+     * @brief _read_edges    Reads a temporal edge list and builds the edges.
+     *                       Contacts are validated and canonicalized before building the edges:
+     *                       invalid rows and self-contacts are dropped, contacts are clipped to
+     *                       the time horizon, and duplicate, overlapping or adjacent contacts of
+     *                       the same node pair are merged. Anomalies are reported in the log.
+     * @param fm_            File manager with the edge list open for read.
+     * @param addNodes_      If true, nodes are added for new labels, otherwise rows with unknown
+     *                       labels are dropped.
+     * @param reverseTime_   If true, network is read in reversed time.
+     * @return               True if edges could be read, false otherwise.
+     */
+    bool _read_edges( mk_file_manager &fm_, bool addNodes_, bool reverseTime_ );
 
 
 public:
@@ -156,10 +451,29 @@ public:
     /***************************
      * Structure manipulations *
      ***************************/
+    /**
+     * @brief set_compact  Sets the storage mode of the activation intervals.
+     * @param compact_     If true, intervals are stored delta encoded in blocks, otherwise as
+     *                     plain vectors.
+     * @note               Has effect on the subsequent calls of create().
+     */
+    void set_compact( bool compact_ );
+
+    /**
+     * @brief set_directed  Sets whether edges are directed.
+     * @param directed_     If true, each temporal edge node1 node2 is read as a directed edge
+     *                      from node1 to node2 and nodes have separate out- and in-neighbors.
+     *                      Otherwise, edges are symmetrized.
+     * @note                Has effect on the subsequent calls of create().
+     */
+    void set_directed( bool directed_ );
+
     /**
      * @brief create        Creates the temporal network based on a temporal edge list.
      * @param filename_     File containing the temporal edges in the following CSV structure:
-     *                      node1 node2 time duration
+     *                      node1 node2 time duration [attribute1 attribute2 ...]
+     *                      Optional numeric attribute columns are named in the header.
+     *                      Columns are separated by blanks, or by commas if the header has any.
      * @param reverseTime_  If true, network is read from the file in reversed time.
      * @return              True if network could be created from file, false otherwise.
      */
@@ -170,7 +484,9 @@ public:
      * @brief create        Creates the temporal network based on nodes and edge lists.
      * @param nodesFile_    File containing the node labels.
      * @param edgesFile_    File containing the temporal edges in the following CSV structure:
-     *                      node1 node2 time duration
+     *                      node1 node2 time duration [attribute1 attribute2 ...]
+     *                      Optional numeric attribute columns are named in the header.
+     *                      Columns are separated by blanks, or by commas if the header has any.
      * @param reverseTime_  If true, network is read from the file in reversed time.
      * @return              True if network could be created from file, false otherwise.
      */
@@ -235,9 +551,63 @@ public:
      */
     int active_neighbor( int nodeId_, int neighborId_ ) const;
 
+    /**
+     * @brief in_degree  Returns the in-degree of a node (regardless of activity).
+     * @param nodeId_    Vector id of the node.
+     * @return           Number of in-neighbors, equals the degree for undirected networks.
+     */
+    int in_degree( int nodeId_ ) const;
+
+    /**
+     * @brief active_in_degree  Returns the number of active in-neighbors of a node.
+     * @param nodeId_           Vector id of the node.
+     * @return                  Number of active in-neighbors, equals the active degree for
+     *                          undirected networks.
+     */
+    int active_in_degree( int nodeId_ ) const;
+
+    /**
+     * @brief in_neighbor    Returns the vector id of an in-neighbor of a node.
+     * @param nodeId_        Vector id of the node to query.
+     * @param neighborId_    Neighbor id of the in-neighbor to query.
+     * @return               Vector id of the in-neighbor if both the node and the in-neighbor
+     *                       exist, -1 otherwise.
+     */
+    int in_neighbor( int nodeId_, int neighborId_ ) const;
+
+    /**
+     * @brief active_in_neighbor  Returns the vector id of an active in-neighbor of a node.
+     * @param nodeId_             Vector id of the node.
+     * @param neighborId_         Neighbor id of the in-neighbor to query.
+     * @return                    Vector id of the active in-neighbor if both the node and the
+     *                            in-neighbor exist, -1 otherwise.
+     */
+    int active_in_neighbor( int nodeId_, int neighborId_ ) const;
+
+    /**
+     * @brief active_attribute  Returns an attribute of the current appearance of an active edge.
+     * @param nodeId_           Vector id of the node.
+     * @param neighborId_       Neighbor id of the active neighbor.
+     * @param attributeId_      Id of the attribute.
+     * @return                  Sum of the attribute over the contacts of the current appearance
+     *                          if node, neighbor and attribute exist, 0 otherwise.
+     */
+    double active_attribute( int nodeId_, int neighborId_, int attributeId_ ) const;
+
+    /**
+     * @brief earliest_arrival  Computes earliest arrival times of time respecting paths from a
+     *                          node, starting at the current time. An edge active at time t
+     *                          transmits to its (out-)neighbor at time t+1.
+     * @param nodeId_           Vector id of the source node.
+     * @param arrivals_         Arrival times will be stored here for each node, -1 if the node
+     *                          is not reachable before max time.
+     */
+    void earliest_arrival( int nodeId_, std::vector<int> &arrivals_ ) const;
+
     /**
      * @brief active_edges  Queries currently active edges.
-     * @param edges_        Edges will be stored here as integer pairs.
+     * @param edges_        Edges will be stored here as integer pairs (source and target in
+     *                      directed mode).
      */
     void active_edges( std::vector<std::pair<int, int> > &edges_ ) const;
 
@@ -246,6 +616,27 @@ public:
     /***************************
      * Global queries *
      ***************************/
+    /**
+     * @brief attributes  Returns the number of contact attributes.
+     * @return            Number of attribute columns.
+     */
+    int attributes() const;
+
+    /**
+     * @brief attribute_name  Returns a constant pointer to the name of an attribute.
+     * @param attributeId_    Id of the attribute.
+     * @return                Constant pointer to the name if attribute id is valid, NULL pointer
+     *                        otherwise.
+     */
+    const std::string* attribute_name( int attributeId_ ) const;
+
+    /**
+     * @brief attribute_id  Returns the id of an attribute.
+     * @param name_         Name of the attribute.
+     * @return              Id of the attribute if exists, -1 otherwise.
+     */
+    int attribute_id( std::string name_ ) const;
+
     /**
      * @brief timeId  Returns current time.
      * @return        Current time.
@@ -272,10 +663,29 @@ public:
 
     /**
      * @brief size  Returns number of static edges (regardless of activity).
+     * @note        In directed mode, opposite edges are counted separately.
      * @return      Number of all possible edges.
      */
     int size() const;
 
+    /**
+     * @brief directed  Returns whether edges are directed.
+     * @return          True if edges are directed, false otherwise.
+     */
+    bool directed() const;
+
+    /**
+     * @brief compact  Returns the storage mode of the activation intervals.
+     * @return         True if intervals are stored in compact mode, false otherwise.
+     */
+    bool compact() const;
+
+    /**
+     * @brief interval_bytes  Returns the memory used by the activation intervals.
+     * @return                Size of interval storage in bytes.
+     */
+    unsigned long interval_bytes() const;
+
     /**
      * @brief k  Returns the temporal average degree.
      * @return   Temporal average degree.
@@ -18,6 +18,15 @@ USER_HOME=$(eval echo ~${SUDO_USER})
 BASHRC="$USER_HOME/.bashrc"
 
 
+# compiler flags, the libraries use threads (programs are linked with -pthread), gzip support
+# needs zlib (programs are then also linked with -lz)
+FLAGS="-O3 -pthread"
+if [[ "$1" == "--zlib" ]]
+then
+  FLAGS="$FLAGS -DMEERKAT_ZLIB"
+fi
+
+
 # libraries
 LIBS=( "meerkat_argument_manager"
        "meerkat_file_manager"
@@ -26,6 +35,8 @@ LIBS=( "meerkat_argument_manager"
        "meerkat_vector2"
        "meerkat_vector3"
        "meerkat_temporal_network"
+       "meerkat_multiplex_network"
+       "meerkat_temporal_gillespie"
       );
 
 
@@ -39,8 +50,8 @@ cp include/*.hpp src/
 
 for lib in ${LIBS[*]}
 do
-  echo "  g++ -c src/$lib.cpp -O3";
-  err=$( g++ -c src/$lib.cpp -O3 2>&1 >/dev/null | tee /dev/stderr );
+  echo "  g++ -c src/$lib.cpp $FLAGS";
+  err=$( g++ -c src/$lib.cpp $FLAGS 2>&1 >/dev/null | tee /dev/stderr );
   if [ "$err" != "" ]
   then
     echo $err;
@@ -1,19 +1,116 @@
 #include "meerkat_file_manager.hpp"
+#ifdef MEERKAT_ZLIB
+#include <zlib.h>
+#endif
+
+/**
+ * @brief The __line_hash struct  Hash of a line view (FNV-1a).
+ */
+struct __line_hash
+{
+    size_t operator()( const meerkat::mk_file_manager::mk_line &line_ ) const
+    {
+        uint64_t h = 14695981039346656037ULL;
+        for( size_t i=0; i<line_._size; i++ )
+            h = (h ^ (unsigned char)line_._data[i]) * 1099511628211ULL;
+        return (size_t)h;
+    }
+};
+
+/**
+ * @brief The __line_equal struct  Equality of line views by content.
+ */
+struct __line_equal
+{
+    bool operator()( const meerkat::mk_file_manager::mk_line &a_,
+                     const meerkat::mk_file_manager::mk_line &b_ ) const
+    {
+        return a_._size == b_._size && memcmp( a_._data, b_._data, a_._size ) == 0;
+    }
+};
+
+std::string meerkat::mk_file_manager::mk_line::str() const
+{
+    return std::string( _data, _size );
+}
+
+/**
+ * @brief The __line_count struct  Line count of decompressed data.
+ */
+struct __line_count
+{
+    int _lines;  // Number of line breaks.
+    char _last;  // Last character.
+};
+
+/**
+ * @brief __count_lines  Sink counting the lines of decompressed data.
+ */
+static bool __count_lines( const char *data_, size_t size_, void *count_ )
+{
+    __line_count *count = (__line_count*)count_;
+    const char *pos = data_, *end = data_ + size_;
+    while( pos < end && (pos = (const char*)memchr(pos, '\n', end-pos)) != NULL )
+    {
+        count->_lines++;
+        pos++;
+    }
+    if( size_ > 0 )
+        count->_last = data_[size_-1];
+    return true;
+}
+
+/**
+ * @brief __first_line  Sink collecting the first line of decompressed data.
+ */
+static bool __first_line( const char *data_, size_t size_, void *line_ )
+{
+    const char *end = (const char*)memchr( data_, '\n', size_ );
+    ((std::string*)line_)->append( data_, end != NULL ? (size_t)(end - data_) : size_ );
+    return end == NULL;
+}
 
 meerkat::mk_file_manager::mk_file_manager()
 {
     _pointer = NULL;
     _state = Empty;
     _fileName = "";
+    _map = NULL;
+    _mapSize = 0;
+    _cursor = 0;
+    memset( _identity, 0, sizeof(_identity) );
+    _sidecar = false;
+    _isIndexed = false;
+    _chunks = NULL;
+    _async = NULL;
+    _outSize = 0;
+    _precision = 6;
+    _blockRows = 0;
+    _blockSize = 0;
+    _decoder = NULL;
+    _encoder = NULL;
+    _line = NULL;
+    _lineCapacity = 0;
+    _offset = 0;
+    _status = Ok;
 }
 
 meerkat::mk_file_manager::~mk_file_manager()
 {
+    stop_chunks();
+    if( _state == Write && _pointer != NULL )
+        flush();
+    _stop_async();
+    _stop_encoder();
+    _stop_decoder();
+    if( _map != NULL )
+        munmap( (void*)_map, _mapSize );
     if( _state != Empty && _pointer != NULL )
         fclose( _pointer );
+    free( _line );
 }
 
-void meerkat::mk_file_manager::_error( const char *message_ ) const
+void meerkat::mk_file_manager::_error( const char *message_, int status_ ) const
 {
     // Print message.
     if( _fileName == "" )
@@ -21,10 +118,8 @@ void meerkat::mk_file_manager::_error( const char *message_ ) const
     else
         printf( "mk_file_manager error: %s (%s).\n", message_, _fileName.c_str() );
 
-    // Close and exit.
-    if( _pointer != NULL )
-        fclose( _pointer );
-    exit( 0 );
+    // Record status, the caller decides whether to continue.
+    _status = status_;
 }
 
 bool meerkat::mk_file_manager::_open( const std::string fileName_, FileState mode_ )
@@ -38,19 +133,25 @@ bool meerkat::mk_file_manager::_open( const std::string fileName_, FileState mod
 
     // Set file name.
     _fileName = fileName_;
+    _status = Ok;
+    _offset = 0;
 
     // Set state.
     _state = mode_;
+    _columnTypes.clear();
+    _blockSize = 0;
 
     // Try to open depending on the state.
     _pointer = NULL;
     switch( _state )
     {
     case Read:
+    case Mapped:
         _pointer = fopen( _fileName.c_str(), "r" );
         break;
     case Write:
         _pointer = fopen( _fileName.c_str(), "w" );
+        _outSize = 0;
         break;
     default:
         return false;
@@ -58,9 +159,178 @@ bool meerkat::mk_file_manager::_open( const std::string fileName_, FileState mod
 
     // Return true if managed to open file.
     if( _pointer == NULL )
+    {
+        _status = _state == Write ? NotWritable : NotReadable;
+        _state = Empty;
         return false;
-    else
-        return true;
+    }
+
+    // Decompress compressed files on a separate thread.
+    if( _state == Read || _state == Mapped )
+    {
+        struct stat info;
+        int codec = Plain;
+        if( fstat(fileno(_pointer), &info) == 0 && S_ISREG(info.st_mode) )
+            codec = _codec_of( _pointer );
+        if( codec != Plain )
+        {
+            FILE *source = _pointer;
+            _pointer = NULL;
+            _state = Read;
+            if( !_start_decoder(source, codec) )
+            {
+                _status = NotReadable;
+                _state = Empty;
+                return false;
+            }
+            return true;
+        }
+    }
+
+    // Map regular files, read others normally.
+    if( _state == Mapped )
+    {
+        struct stat info;
+        _map = NULL;
+        _mapSize = 0;
+        _cursor = 0;
+        _isIndexed = false;
+        _offsets.clear();
+        if( fstat(fileno(_pointer), &info) != 0 || !S_ISREG(info.st_mode) )
+            _state = Read;
+        else if( info.st_size > 0 )
+        {
+            _identity[0] = (uint64_t)info.st_mtime;
+#ifdef __APPLE__
+            _identity[1] = (uint64_t)info.st_mtimespec.tv_nsec;
+#else
+            _identity[1] = (uint64_t)info.st_mtim.tv_nsec;
+#endif
+            _identity[2] = (uint64_t)info.st_ino;
+            void *map = mmap( NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE,
+                              fileno(_pointer), 0 );
+            if( map == MAP_FAILED )
+                _state = Read;
+            else
+            {
+                madvise( map, (size_t)info.st_size, MADV_SEQUENTIAL );
+                _map = (const char*)map;
+                _mapSize = (size_t)info.st_size;
+            }
+        }
+    }
+    return true;
+}
+
+void meerkat::mk_file_manager::_scan_lines( const char *map_, size_t size_, size_t begin_,
+                                            size_t end_, std::vector<size_t> *offsets_ )
+{
+    const char *pos = map_ + begin_, *end = map_ + end_;
+    while( pos < end && (pos = (const char*)memchr(pos, '\n', end-pos)) != NULL )
+    {
+        pos++;
+        if( (size_t)(pos - map_) < size_ )
+            offsets_->push_back( (size_t)(pos - map_) );
+    }
+}
+
+void meerkat::mk_file_manager::_index() const
+{
+    if( _isIndexed )
+        return;
+    _isIndexed = true;
+    _offsets.clear();
+    if( _mapSize == 0 || (_sidecar && _load_index()) )
+        return;
+
+    // Scan chunks in parallel for large files
+    int numThreads = (int)std::thread::hardware_concurrency();
+    if( numThreads < 2 || _mapSize < (1 << 22) )
+        numThreads = 1;
+    std::vector<std::vector<size_t> > parts( numThreads );
+    std::vector<std::thread> threads;
+    for( int t=0; t<numThreads; t++ )
+    {
+        threads.push_back( std::thread(_scan_lines, _map, _mapSize,
+                                       _mapSize * t / numThreads,
+                                       _mapSize * (t+1) / numThreads, &parts[t]) );
+    }
+    for( int t=0; t<numThreads; t++ )
+        threads[t].join();
+
+    // First line and the rest in order
+    size_t total = 1;
+    for( int t=0; t<numThreads; t++ )
+        total += parts[t].size();
+    _offsets.reserve( total );
+    _offsets.push_back( 0 );
+    for( int t=0; t<numThreads; t++ )
+        _offsets.insert( _offsets.end(), parts[t].begin(), parts[t].end() );
+
+    if( _sidecar )
+        _save_index();
+}
+
+uint64_t meerkat::mk_file_manager::_sample_hash() const
+{
+    // First and last 4 kB
+    const size_t block = 4096;
+    size_t ranges[2][2] = {{0, _mapSize < block ? _mapSize : block},
+                           {_mapSize > block ? _mapSize - block : 0, _mapSize}};
+    uint64_t hash = 14695981039346656037ULL;
+    for( int r=0; r<2; r++ )
+    {
+        for( size_t i=ranges[r][0]; i<ranges[r][1]; i++ )
+        {
+            hash ^= (unsigned char)_map[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+bool meerkat::mk_file_manager::_load_index() const
+{
+    FILE *file = fopen( (_fileName + ".idx").c_str(), "rb" );
+    if( file == NULL )
+        return false;
+
+    // Header: magic, file size, modification time (s, ns), inode, sample hash, number of lines
+    char magic[8];
+    uint64_t header[6];
+    bool valid = fread( magic, 1, 8, file ) == 8 && memcmp( magic, "MKLIDX2", 8 ) == 0
+            && fread( header, sizeof(uint64_t), 6, file ) == 6
+            && header[0] == (uint64_t)_mapSize
+            && memcmp( header+1, _identity, sizeof(_identity) ) == 0
+            && header[4] == _sample_hash();
+    if( valid )
+    {
+        std::vector<uint64_t> offsets( (size_t)header[5] );
+        valid = fread( offsets.data(), sizeof(uint64_t), offsets.size(), file ) == offsets.size()
+                && !offsets.empty() && offsets[0] == 0;
+        if( valid )
+            _offsets.assign( offsets.begin(), offsets.end() );
+    }
+    fclose( file );
+    return valid;
+}
+
+void meerkat::mk_file_manager::_save_index() const
+{
+    FILE *file = fopen( (_fileName + ".idx").c_str(), "wb" );
+    if( file == NULL )
+    {
+        printf( "mk_file_manager warning: cannot write line index (%s.idx).\n",
+                _fileName.c_str() );
+        return;
+    }
+    uint64_t header[6] = {(uint64_t)_mapSize, _identity[0], _identity[1], _identity[2],
+                          _sample_hash(), (uint64_t)_offsets.size()};
+    std::vector<uint64_t> offsets( _offsets.begin(), _offsets.end() );
+    fwrite( "MKLIDX2", 1, 8, file );
+    fwrite( header, sizeof(uint64_t), 6, file );
+    fwrite( offsets.data(), sizeof(uint64_t), offsets.size(), file );
+    fclose( file );
 }
 
 bool meerkat::mk_file_manager::read( const std::string fileName_ )
@@ -68,39 +338,165 @@ bool meerkat::mk_file_manager::read( const std::string fileName_ )
     return _open(fileName_, Read);
 }
 
-bool meerkat::mk_file_manager::write( const std::string fileName_ )
+bool meerkat::mk_file_manager::map( const std::string fileName_, bool sidecar_ )
+{
+    _sidecar = sidecar_;
+    return _open(fileName_, Mapped);
+}
+
+bool meerkat::mk_file_manager::write( const std::string fileName_, bool async_ )
 {
-    return _open(fileName_, Write);
+    // Compression by extension
+    int codec = Plain;
+    size_t len = fileName_.size();
+    if( len > 4 && fileName_.compare(len-4, 4, ".mkz") == 0 )
+        codec = Lz;
+    else if( len > 3 && fileName_.compare(len-3, 3, ".gz") == 0 )
+        codec = Gzip;
+
+#ifndef MEERKAT_ZLIB
+    // Do not write a plain file named as gzip
+    if( codec == Gzip )
+    {
+        printf( "mk_file_manager warning: gzip output needs MEERKAT_ZLIB (%s).\n",
+                fileName_.c_str() );
+        _status = NotWritable;
+        return false;
+    }
+#endif
+    if( !_open(fileName_, Write) )
+        return false;
+
+    if( codec != Plain )
+    {
+        _encoder = new __encoder;
+        _encoder->_codec = codec;
+        _encoder->_stream = NULL;
+        if( codec == Lz )
+        {
+            fwrite( "MKLZ", 1, 4, _pointer );
+            _encoder->_table.assign( 1 << 16, 0 );
+        }
+#ifdef MEERKAT_ZLIB
+        else
+        {
+            z_stream *stream = new z_stream;
+            memset( stream, 0, sizeof(z_stream) );
+            if( deflateInit2(stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15+16, 8,
+                             Z_DEFAULT_STRATEGY) != Z_OK )
+            {
+                printf( "mk_file_manager warning: cannot initialize gzip (%s).\n",
+                        fileName_.c_str() );
+                delete stream;
+                delete _encoder;
+                _encoder = NULL;
+                close();
+                _status = NotWritable;
+                return false;
+            }
+            _encoder->_stream = stream;
+        }
+#endif
+    }
+
+    if( async_ )
+    {
+        _async = new __async_writer;
+        _async->_blocks.assign( 4, std::vector<char>() );
+        _async->_sizes.assign( 4, 0 );
+        _async->_head = 0;
+        _async->_tail = 0;
+        _async->_closing = false;
+        _async->_failed = false;
+        _async->_pointer = _pointer;
+        _async->_encoder = _encoder;
+        _async->_thread = std::thread( _async_worker, _async );
+    }
+    return true;
 }
 
 void meerkat::mk_file_manager::close()
 {
+    stop_chunks();
+    if( _state == Write && _pointer != NULL )
+        flush();
+    _stop_async();
+    _stop_encoder();
+    _stop_decoder();
+    if( _map != NULL )
+        munmap( (void*)_map, _mapSize );
+    _map = NULL;
+    _mapSize = 0;
+    _cursor = 0;
+    _isIndexed = false;
+    _offsets.clear();
     if( _pointer != NULL )
         fclose( _pointer );
+    _pointer = NULL;
     _state = Empty;
     _fileName = "";
 }
 
 void meerkat::mk_file_manager::reset()
 {
-    if (_state == Read)
+    stop_chunks();
+    if (_state == Read && _decoder != NULL)
+    {
+        // Restart decompression
+        int codec = _decoder->_codec;
+        _stop_decoder();
+        FILE *source = fopen( _fileName.c_str(), "rb" );
+        if( source == NULL || _codec_of(source) != codec || !_start_decoder(source, codec) )
+            _error( "cannot restart decompression", ReadFailed );
+        _offset = 0;
+    }
+    else if (_state == Read)
         fseek( _pointer, 0, SEEK_SET );
+    if (_state == Mapped)
+        _cursor = 0;
 }
 
 int meerkat::mk_file_manager::rows() const
 {
-    if (_state == Read)
+    if (_state == Mapped)
+    {
+        _index();
+        return (int)_offsets.size();
+    }
+    else if (_state == Read && _decoder != NULL)
     {
-        char line[1024] = {""};
+        // Count lines of a separately decompressed copy
+        __line_count count = {0, '\n'};
+        FILE *source = fopen( _fileName.c_str(), "rb" );
+        if( source == NULL )
+            return -1;
+        if( _codec_of(source) == _decoder->_codec )
+            _decode( source, _decoder->_codec, __count_lines, &count );
+        fclose( source );
+        return count._last != '\n' ? count._lines+1 : count._lines;
+    }
+    else if (_state == Read)
+    {
+        // Count line breaks block by block, and the last line if it is not terminated
+        char block[65536];
+        size_t len;
+        const char *pos, *end;
+        char last = '\n';
         int r = 0;
         fseek( _pointer, 0, SEEK_SET );
-        while( !feof(_pointer) )
+        while( (len = fread(block, 1, sizeof(block), _pointer)) > 0 )
         {
-            fgets( line, sizeof(line), _pointer );
-            r++;
+            pos = block;
+            end = block + len;
+            while( pos < end && (pos = (const char*)memchr(pos, '\n', end-pos)) != NULL )
+            {
+                r++;
+                pos++;
+            }
+            last = block[len-1];
         }
         fseek( _pointer, 0, SEEK_SET );
-        return r-1;
+        return last != '\n' ? r+1 : r;
     }
     else
     {
@@ -109,20 +505,157 @@ int meerkat::mk_file_manager::rows() const
     }
 }
 
+bool meerkat::mk_file_manager::mapped() const
+{
+    return _state == Mapped;
+}
+
+int meerkat::mk_file_manager::status() const
+{
+    return _status;
+}
+
+void meerkat::mk_file_manager::clear_status()
+{
+    _status = Ok;
+}
+
+size_t meerkat::mk_file_manager::offset() const
+{
+    if( _state == Mapped )
+        return _cursor;
+    if( _state == Read && _decoder != NULL )
+        return _offset;
+    if( _state == Read )
+    {
+        long pos = ftell( _pointer );
+        return pos >= 0 ? (size_t)pos : 0;
+    }
+    return 0;
+}
+
+bool meerkat::mk_file_manager::seek_offset( size_t offset_ )
+{
+    stop_chunks();
+    if( _state == Mapped )
+    {
+        if( offset_ > _mapSize )
+            return false;
+        _cursor = offset_;
+        return true;
+    }
+    else if( _state == Read && _decoder != NULL )
+    {
+        // Decompress again up to the offset
+        reset();
+        char block[65536];
+        size_t len;
+        while( _offset < offset_ )
+        {
+            len = offset_ - _offset < sizeof(block) ? offset_ - _offset : sizeof(block);
+            len = fread( block, 1, len, _pointer );
+            if( len == 0 )
+                return false;
+            _offset += len;
+        }
+        return true;
+    }
+    else if( _state == Read )
+        return fseek( _pointer, (long)offset_, SEEK_SET ) == 0;
+    else
+    {
+        _error( "file is not readable", NotReadable );
+        return false;
+    }
+}
+
+bool meerkat::mk_file_manager::line( int lineId_, mk_line &line_ ) const
+{
+    if( _state != Mapped )
+    {
+        printf( "mk_file_manager warning: file is not mapped.\n" );
+        return false;
+    }
+    _index();
+    if( lineId_ < 0 || lineId_ >= (int)_offsets.size() )
+        return false;
+
+    // Line ends before the next line, or at the end of file
+    size_t begin = _offsets[lineId_];
+    size_t end = lineId_+1 < (int)_offsets.size() ? _offsets[lineId_+1]-1 : _mapSize;
+    if( end > begin && _map[end-1] == '\n' )
+        end--;
+    if( end > begin && _map[end-1] == '\r' )
+        end--;
+    line_._data = _map + begin;
+    line_._size = end - begin;
+    return true;
+}
+
+bool meerkat::mk_file_manager::seek_line( int lineId_ )
+{
+    if( _state != Mapped )
+    {
+        printf( "mk_file_manager warning: file is not mapped.\n" );
+        return false;
+    }
+    _index();
+    if( lineId_ < 0 || lineId_ > (int)_offsets.size() )
+        return false;
+    _cursor = lineId_ < (int)_offsets.size() ? _offsets[lineId_] : _mapSize;
+    return true;
+}
+
 int meerkat::mk_file_manager::cols() const
 {
-    if (_state == Read)
+    if (_state == Mapped)
     {
-        char line[1024] = {""};
-        char *line_ptr = fgets( line, sizeof(line), _pointer );
-        char col[1024] = {""};
-        int c = 0, shift = 0;
-        fseek( _pointer, 0, SEEK_SET );
-        while( sscanf(line_ptr, "%s%n", col, &shift) == 1 )
+        // Count tokens of the first line
+        int c = 0;
+        bool inToken = false;
+        for( size_t i=0; i<_mapSize && _map[i] != '\n'; i++ )
         {
-            c++;
-            line_ptr += shift;
+            if( _map[i] == ' ' || _map[i] == '\t' || _map[i] == '\r' )
+                inToken = false;
+            else if( !inToken )
+            {
+                inToken = true;
+                c++;
+            }
         }
+        return c;
+    }
+    else if (_state == Read && _decoder != NULL)
+    {
+        // Count tokens of the first line of a separately decompressed copy
+        std::string line;
+        FILE *source = fopen( _fileName.c_str(), "rb" );
+        if( source == NULL )
+            return -1;
+        if( _codec_of(source) == _decoder->_codec )
+            _decode( source, _decoder->_codec, __first_line, &line );
+        fclose( source );
+        mk_line token;
+        const char *pos = line.c_str(), *end = pos + line.size();
+        int c = 0;
+        while( parse_token(pos, end, token) )
+            c++;
+        return c;
+    }
+    else if (_state == Read)
+    {
+        // Count tokens of the current line, then return to the top
+        char *line = NULL;
+        size_t capacity = 0;
+        ssize_t len = getline( &line, &capacity, _pointer );
+        mk_line token;
+        const char *pos = line, *end = line + (len > 0 ? len : 0);
+        if( end > pos && end[-1] == '\n' )
+            end--;
+        int c = 0;
+        while( parse_token(pos, end, token) )
+            c++;
+        free( line );
         fseek( _pointer, 0, SEEK_SET );
         return c;
     }
@@ -137,16 +670,13 @@ bool meerkat::mk_file_manager::put( std::vector<double> &data_ )
 {
     if( _state == Write )
     {
-        int len = (int)data_.size();
-        fprintf( _pointer, "%lg", data_[0] );
-        for(int i=1; i<len; i++)
-            fprintf( _pointer, " %lg", data_[i] );
-        fprintf( _pointer, "\n" );
+        _put_row( data_.empty() ? NULL : &data_[0], (int)data_.size() );
         return true;
     }
     else
     {
         printf( "mk_file_manager warning: file is not open for write.\n" );
+        _status = NotWritable;
         return false;
     }
 }
@@ -155,52 +685,1279 @@ bool meerkat::mk_file_manager::put( char *text_ )
 {
     if( _state == Write)
     {
-        fprintf( _pointer, "%s\n", text_ );
+        size_t len = strlen( text_ );
+        char *pos = _reserve( len+1 );
+        memcpy( pos, text_, len );
+        pos[len] = '\n';
+        _outSize += len+1;
         return true;
     }
     else
     {
         printf( "mk_file_manager warning: file is not open for write.\n" );
+        _status = NotWritable;
         return false;
     }
 }
 
-std::vector<double> meerkat::mk_file_manager::get_data()
+bool meerkat::mk_file_manager::put_rows( const std::vector<std::vector<double> > &data_ )
 {
-    if(_state == Read)
+    if( _state == Write )
     {
-        int numDataElement = 0;
-        int shift = 0;
-        double dataElement = 0.0;
-        char *dataLine, line[1024] = {""};
-        std::vector<double> data;
-        dataLine = fgets( line, sizeof(line), _pointer );
-        while( sscanf(dataLine, "%lf%n", &dataElement, &shift) == 1 )
+        for( int r=0; r<(int)data_.size(); r++ )
+            _put_row( data_[r].empty() ? NULL : &data_[r][0], (int)data_[r].size() );
+        return true;
+    }
+    else
+    {
+        printf( "mk_file_manager warning: file is not open for write.\n" );
+        _status = NotWritable;
+        return false;
+    }
+}
+
+bool meerkat::mk_file_manager::put_rows( const double *data_, int numRows_, int numCols_ )
+{
+    if( _state == Write )
+    {
+        for( int r=0; r<numRows_; r++ )
+            _put_row( data_ + (size_t)r*numCols_, numCols_ );
+        return true;
+    }
+    else
+    {
+        printf( "mk_file_manager warning: file is not open for write.\n" );
+        _status = NotWritable;
+        return false;
+    }
+}
+
+bool meerkat::mk_file_manager::set_columns( const std::vector<std::string> &names_,
+                                            const std::vector<int> &types_, int blockRows_ )
+{
+    if( _state != Write )
+    {
+        printf( "mk_file_manager warning: file is not open for write.\n" );
+        _status = NotWritable;
+        return false;
+    }
+    if( !_columnTypes.empty() )
+    {
+        printf( "mk_file_manager warning: columns are already set.\n" );
+        return false;
+    }
+    if( names_.empty() || names_.size() != types_.size() || blockRows_ <= 0 )
+    {
+        printf( "mk_file_manager warning: invalid columns.\n" );
+        return false;
+    }
+    for( int c=0; c<(int)types_.size(); c++ )
+    {
+        if( types_[c] != Unsigned && types_[c] != Real )
         {
-            data.push_back( dataElement );
-            numDataElement++;
-            dataLine += shift;
+            printf( "mk_file_manager warning: invalid column type.\n" );
+            return false;
         }
-        return data;
     }
-    else
+
+    // Header, padded to 8 bytes
+    uint32_t numbers[2] = {(uint32_t)types_.size(), (uint32_t)blockRows_};
+    size_t size = 8 + sizeof(numbers);
+    for( int c=0; c<(int)names_.size(); c++ )
+        size += 2*sizeof(uint32_t) + names_[c].size();
+    size = (size + 7) / 8 * 8;
+    char *pos = _reserve( size );
+    memset( pos, 0, size );
+    memcpy( pos, "MKCOL1", 6 );
+    memcpy( pos+8, numbers, sizeof(numbers) );
+    char *column = pos + 8 + sizeof(numbers);
+    for( int c=0; c<(int)names_.size(); c++ )
     {
-        _error( "file is not readable" );
-        return std::vector<double>();
+        numbers[0] = (uint32_t)types_[c];
+        numbers[1] = (uint32_t)names_[c].size();
+        memcpy( column, numbers, sizeof(numbers) );
+        memcpy( column + sizeof(numbers), names_[c].data(), names_[c].size() );
+        column += sizeof(numbers) + names_[c].size();
     }
+    _outSize += size;
+
+    _columnTypes = types_;
+    _blockRows = blockRows_;
+    _block.assign( (size_t)blockRows_ * types_.size(), 0 );
+    _blockSize = 0;
+    return true;
 }
 
-std::string meerkat::mk_file_manager::get_line()
+bool meerkat::mk_file_manager::put_record( const std::vector<double> &data_ )
+{
+    if( _state != Write || _columnTypes.empty() )
+    {
+        printf( "mk_file_manager warning: file is not open for binary write.\n" );
+        _status = NotWritable;
+        return false;
+    }
+    int numColumns = (int)_columnTypes.size();
+    if( (int)data_.size() != numColumns )
+    {
+        printf( "mk_file_manager warning: record has %i columns instead of %i.\n",
+                (int)data_.size(), numColumns );
+        return false;
+    }
+
+    // Store values as 8-byte words
+    uint64_t *value = &_block[_blockSize];
+    for( int c=0; c<numColumns; c++, value += _blockRows )
+    {
+        if( _columnTypes[c] == Unsigned )
+            *value = data_[c] > 0.0 ? (uint64_t)data_[c] : 0;
+        else
+            memcpy( value, &data_[c], sizeof(double) );
+    }
+    if( ++_blockSize == _blockRows )
+        _put_block();
+    return true;
+}
+
+bool meerkat::mk_file_manager::get_columns( std::vector<std::string> &names_,
+                                            std::vector<int> &types_ )
+{
+    names_.clear();
+    types_.clear();
+    if( _state != Mapped )
+    {
+        printf( "mk_file_manager warning: file is not mapped.\n" );
+        return false;
+    }
+    if( _mapSize < 16 || memcmp(_map, "MKCOL1", 6) != 0 )
+        return false;
+
+    // Columns, then blocks from the next 8-byte boundary
+    uint32_t numbers[2];
+    memcpy( numbers, _map+8, sizeof(numbers) );
+    int numColumns = (int)numbers[0], blockRows = (int)numbers[1];
+    size_t pos = 8 + sizeof(numbers);
+    for( int c=0; c<numColumns; c++ )
+    {
+        if( pos + sizeof(numbers) > _mapSize )
+            break;
+        memcpy( numbers, _map+pos, sizeof(numbers) );
+        pos += sizeof(numbers);
+        if( pos + numbers[1] > _mapSize || (numbers[0] != Unsigned && numbers[0] != Real) )
+            break;
+        types_.push_back( (int)numbers[0] );
+        names_.push_back( std::string(_map+pos, numbers[1]) );
+        pos += numbers[1];
+    }
+    if( (int)types_.size() != numColumns || numColumns == 0 )
+    {
+        printf( "mk_file_manager warning: invalid header of binary file (%s).\n",
+                _fileName.c_str() );
+        names_.clear();
+        types_.clear();
+        return false;
+    }
+
+    _columnTypes = types_;
+    _blockRows = blockRows;
+    _cursor = (pos + 7) / 8 * 8;
+    return true;
+}
+
+bool meerkat::mk_file_manager::next_block( mk_block &block_ )
+{
+    if( _state != Mapped || _columnTypes.empty() )
+    {
+        printf( "mk_file_manager warning: file is not mapped for binary read.\n" );
+        return false;
+    }
+    if( _cursor + sizeof(uint64_t) > _mapSize )
+        return false;
+
+    // Number of rows, then the columns in turn
+    uint64_t rows;
+    memcpy( &rows, _map+_cursor, sizeof(uint64_t) );
+    size_t numColumns = _columnTypes.size();
+    if( rows > (_mapSize - _cursor - sizeof(uint64_t)) / sizeof(uint64_t) / numColumns )
+    {
+        printf( "mk_file_manager warning: truncated block in binary file (%s).\n",
+                _fileName.c_str() );
+        _cursor = _mapSize;
+        return false;
+    }
+    const char *values = _map + _cursor + sizeof(uint64_t);
+    block_._rows = (size_t)rows;
+    block_._reals.assign( numColumns, NULL );
+    block_._integers.assign( numColumns, NULL );
+    for( size_t c=0; c<numColumns; c++, values += rows*sizeof(uint64_t) )
+    {
+        if( _columnTypes[c] == Real )
+            block_._reals[c] = (const double*)values;
+        else
+            block_._integers[c] = (const uint64_t*)values;
+    }
+    _cursor = (size_t)(values - _map);
+    return true;
+}
+
+void meerkat::mk_file_manager::set_precision( int digits_ )
+{
+    _precision = digits_ < 0 ? 0 : (digits_ > 17 ? 17 : digits_);
+}
+
+bool meerkat::mk_file_manager::flush()
+{
+    if( _state != Write )
+    {
+        printf( "mk_file_manager warning: file is not open for write.\n" );
+        _status = NotWritable;
+        return false;
+    }
+
+    if( _blockSize > 0 )
+        _put_block();
+
+    bool written = _outSize == 0 || _write_out();
+    if( _async != NULL )
+    {
+        // Wait until the writer thread catches up
+        std::unique_lock<std::mutex> lock( _async->_mutex );
+        while( _async->_tail.load() != _async->_head.load() )
+            _async->_written.wait( lock );
+        written = !_async->_failed.load();
+    }
+    if( !written || fflush(_pointer) != 0 )
+    {
+        printf( "mk_file_manager warning: cannot write file (%s).\n", _fileName.c_str() );
+        _status = WriteFailed;
+        return false;
+    }
+    return true;
+}
+
+std::vector<double> meerkat::mk_file_manager::get_data()
 {
-    if(_state == Read)
+    if(_state == Mapped)
     {
-        char line[1024] = {""};
-        fgets( line, 1023, _pointer );
-        return std::string(line);
+        std::vector<double> data;
+        get_data( data );
+        return data;
+    }
+    else if(_state == Read)
+    {
+        std::vector<double> data;
+        get_data( data );
+        return data;
     }
     else
     {
-        _error( "file is not readable" );
-        return "";
+        _error( "file is not readable", NotReadable );
+        return std::vector<double>();
     }
 }
+
+bool meerkat::mk_file_manager::get_data( std::vector<double> &data_ )
+{
+    // Columns up to the first one that is not a number
+    data_.clear();
+    mk_line line;
+    if( !next_line(line) )
+        return false;
+    const char *pos = line._data, *end = line._data + line._size;
+    double value;
+    while( parse_double(pos, end, value) )
+        data_.push_back( value );
+    return true;
+}
+
+std::string meerkat::mk_file_manager::get_line()
+{
+    if(_state == Mapped)
+    {
+        // Line with its line break, as read from file
+        if( _cursor >= _mapSize )
+            return "";
+        const char *begin = _map + _cursor;
+        const char *end = (const char*)memchr( begin, '\n', _mapSize - _cursor );
+        size_t size = end != NULL ? (size_t)(end - begin) + 1 : _mapSize - _cursor;
+        _cursor += size;
+        return std::string( begin, size );
+    }
+    else if(_state == Read)
+    {
+        // Line with its line break, as read from file
+        long len = _read_line();
+        return len > 0 ? std::string( _line, (size_t)len ) : "";
+    }
+    else
+    {
+        _error( "file is not readable", NotReadable );
+        return "";
+    }
+}
+
+bool meerkat::mk_file_manager::next_line( mk_line &line_ )
+{
+    if( _state == Mapped )
+    {
+        if( _cursor >= _mapSize )
+            return false;
+        const char *begin = _map + _cursor;
+        const char *end = (const char*)memchr( begin, '\n', _mapSize - _cursor );
+        size_t size = end != NULL ? (size_t)(end - begin) : _mapSize - _cursor;
+        _cursor += end != NULL ? size+1 : size;
+        line_._data = begin;
+        line_._size = size > 0 && begin[size-1] == '\r' ? size-1 : size;
+        return true;
+    }
+    else if( _state == Read )
+    {
+        long len = _read_line();
+        if( len < 0 )
+            return false;
+        if( len > 0 && _line[len-1] == '\n' )
+            len--;
+        if( len > 0 && _line[len-1] == '\r' )
+            len--;
+        line_._data = _line;
+        line_._size = (size_t)len;
+        return true;
+    }
+    else
+    {
+        _error( "file is not readable", NotReadable );
+        return false;
+    }
+}
+
+const char *meerkat::mk_file_manager::_field_end( const char *pos_, const char *end_,
+                                                  char separator_ )
+{
+#ifdef __SSE2__
+    const __m128i space = _mm_set1_epi8( ' ' );
+    const __m128i tab = _mm_set1_epi8( '\t' );
+    const __m128i cr = _mm_set1_epi8( '\r' );
+    const __m128i sep = _mm_set1_epi8( separator_ );
+    __m128i chars;
+    int mask;
+    while( end_ - pos_ >= 16 )
+    {
+        chars = _mm_loadu_si128( (const __m128i*)pos_ );
+        mask = _mm_movemask_epi8( _mm_or_si128(
+                                      _mm_or_si128(_mm_cmpeq_epi8(chars, space),
+                                                   _mm_cmpeq_epi8(chars, tab)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(chars, cr),
+                                                   _mm_cmpeq_epi8(chars, sep))) );
+        if( mask != 0 )
+            return pos_ + __builtin_ctz( mask );
+        pos_ += 16;
+    }
+#endif
+    while( pos_ < end_ && *pos_ != ' ' && *pos_ != '\t' && *pos_ != '\r' && *pos_ != separator_ )
+        pos_++;
+    return pos_;
+}
+
+bool meerkat::mk_file_manager::_field_begin( const char *&pos_, const char *end_, char separator_ )
+{
+    bool separated = false;
+    while( pos_ < end_ )
+    {
+        if( *pos_ == ' ' || *pos_ == '\t' || *pos_ == '\r' )
+            pos_++;
+        else if( *pos_ == separator_ && !separated )
+        {
+            separated = true;
+            pos_++;
+        }
+        else
+            break;
+    }
+    return pos_ < end_ && *pos_ != separator_;
+}
+
+bool meerkat::mk_file_manager::parse_token( const char *&pos_, const char *end_, mk_line &token_,
+                                            char separator_ )
+{
+    if( !_field_begin(pos_, end_, separator_) )
+        return false;
+    token_._data = pos_;
+    pos_ = _field_end( pos_, end_, separator_ );
+    token_._size = (size_t)(pos_ - token_._data);
+    return true;
+}
+
+bool meerkat::mk_file_manager::parse_int( const char *&pos_, const char *end_, int &value_,
+                                          char separator_ )
+{
+    const char *pos = pos_;
+    if( !_field_begin(pos, end_, separator_) )
+        return false;
+
+    // Sign, then digits up to the end of the field
+    bool negative = *pos == '-';
+    if( *pos == '-' || *pos == '+' )
+        pos++;
+    const char *digits = pos;
+    long long value = 0;
+    while( pos < end_ && *pos >= '0' && *pos <= '9' && value <= INT_MAX )
+        value = 10*value + (*pos++ - '0');
+    if( negative )
+        value = -value;
+    if( pos == digits || value > INT_MAX || value < INT_MIN || _field_end(pos, end_, separator_) != pos )
+        return false;
+    value_ = (int)value;
+    pos_ = pos;
+    return true;
+}
+
+bool meerkat::mk_file_manager::parse_ulong( const char *&pos_, const char *end_,
+                                            unsigned long &value_, char separator_ )
+{
+    const char *pos = pos_;
+    if( !_field_begin(pos, end_, separator_) )
+        return false;
+
+    // Digits up to the end of the field
+    const char *digits = pos;
+    unsigned long value = 0, digit;
+    while( pos < end_ && *pos >= '0' && *pos <= '9' )
+    {
+        digit = (unsigned long)(*pos++ - '0');
+        if( value > (ULONG_MAX - digit) / 10 )
+            return false;
+        value = 10*value + digit;
+    }
+    if( pos == digits || _field_end(pos, end_, separator_) != pos )
+        return false;
+    value_ = value;
+    pos_ = pos;
+    return true;
+}
+
+bool meerkat::mk_file_manager::parse_double( const char *&pos_, const char *end_, double &value_,
+                                             char separator_ )
+{
+    const char *pos = pos_;
+    if( !_field_begin(pos, end_, separator_) )
+        return false;
+    const char *end = _field_end( pos, end_, separator_ );
+    if( *pos == '+' && end - pos > 1 && pos[1] != '-' )
+        pos++;
+
+#if defined(__cpp_lib_to_chars)
+    std::from_chars_result result = std::from_chars( pos, end, value_ );
+    if( result.ec != std::errc() || result.ptr != end )
+        return false;
+#else
+    // Terminated copy for strtod, hexadecimal is rejected as by from_chars
+    char field[128];
+    char *endPtr;
+    if( end - pos >= (long)sizeof(field) || memchr(pos, 'x', end - pos) != NULL
+            || memchr(pos, 'X', end - pos) != NULL )
+        return false;
+    memcpy( field, pos, end - pos );
+    field[end-pos] = '\0';
+    value_ = strtod( field, &endPtr );
+    if( endPtr != field + (end-pos) )
+        return false;
+#endif
+    pos_ = end;
+    return true;
+}
+
+const char *meerkat::mk_file_manager::_chunk_begin( const __chunk_reader *reader_, size_t chunk_ )
+{
+    if( chunk_ == 0 )
+        return reader_->_begin;
+    if( chunk_ >= reader_->_numChunks )
+        return reader_->_end;
+
+    // Line starting after the last line break before the boundary
+    const char *pos = reader_->_begin + chunk_ * reader_->_chunkSize - 1;
+    pos = (const char*)memchr( pos, '\n', reader_->_end - pos );
+    return pos != NULL ? pos+1 : reader_->_end;
+}
+
+void meerkat::mk_file_manager::_parse_chunk( const __chunk_reader *reader_, const char *begin_,
+                                             const char *end_, mk_chunk &chunk_ )
+{
+    const std::vector<int> &types = reader_->_types;
+    int numColumns = (int)types.size(), required = reader_->_required;
+    char separator = reader_->_separator;
+    chunk_._rows = 0;
+    chunk_._invalid = 0;
+    chunk_._labels.clear();
+    chunk_._columns.resize( numColumns );
+    for( int c=0; c<numColumns; c++ )
+    {
+        chunk_._columns[c]._type = types[c];
+        chunk_._columns[c]._tokens.clear();
+        chunk_._columns[c]._labels.clear();
+        chunk_._columns[c]._integers.clear();
+        chunk_._columns[c]._reals.clear();
+    }
+
+    // Fields of the current line, stored only if the line is valid
+    std::vector<mk_line> tokens( numColumns );
+    std::vector<unsigned long> integers( numColumns );
+    std::vector<double> reals( numColumns );
+    std::unordered_map<mk_line, int, __line_hash, __line_equal> labelIds;
+    std::pair<std::unordered_map<mk_line, int, __line_hash, __line_equal>::iterator, bool> added;
+    const char *line = begin_, *lineEnd, *pos;
+    mk_line skipped;
+    bool valid;
+    while( line < end_ )
+    {
+        lineEnd = (const char*)memchr( line, '\n', end_ - line );
+        if( lineEnd == NULL )
+            lineEnd = end_;
+        pos = line;
+        line = lineEnd < end_ ? lineEnd+1 : end_;
+
+        valid = true;
+        for( int c=0; c<numColumns && valid; c++ )
+        {
+            switch( types[c] )
+            {
+            case Token:
+            case Label:
+                if( !parse_token(pos, lineEnd, tokens[c], separator) )
+                {
+                    tokens[c]._data = lineEnd;
+                    tokens[c]._size = 0;
+                    valid = c >= required;
+                }
+                break;
+            case Unsigned:
+                if( !parse_ulong(pos, lineEnd, integers[c], separator) )
+                {
+                    integers[c] = 0;
+                    valid = c >= required;
+                    parse_token( pos, lineEnd, skipped, separator );
+                }
+                break;
+            default:
+                if( !parse_double(pos, lineEnd, reals[c], separator) )
+                {
+                    reals[c] = 0.0;
+                    valid = c >= required;
+                    parse_token( pos, lineEnd, skipped, separator );
+                }
+                break;
+            }
+        }
+        if( !valid )
+        {
+            chunk_._invalid++;
+            continue;
+        }
+
+        for( int c=0; c<numColumns; c++ )
+        {
+            mk_column &column = chunk_._columns[c];
+            switch( types[c] )
+            {
+            case Token:
+                column._tokens.push_back( tokens[c] );
+                break;
+            case Label:
+                if( tokens[c]._size == 0 )
+                    column._labels.push_back( -1 );
+                else
+                {
+                    added = labelIds.insert( std::make_pair(tokens[c], (int)chunk_._labels.size()) );
+                    if( added.second )
+                        chunk_._labels.push_back( tokens[c] );
+                    column._labels.push_back( added.first->second );
+                }
+                break;
+            case Unsigned:
+                column._integers.push_back( integers[c] );
+                break;
+            default:
+                column._reals.push_back( reals[c] );
+                break;
+            }
+        }
+        chunk_._rows++;
+    }
+}
+
+void meerkat::mk_file_manager::_chunk_worker( __chunk_reader *reader_ )
+{
+    mk_chunk chunk;
+    size_t k;
+    while( true )
+    {
+        // Take the next chunk if not too far ahead of the consumer
+        {
+            std::unique_lock<std::mutex> lock( reader_->_mutex );
+            while( !reader_->_stop && reader_->_claimed < reader_->_numChunks
+                   && reader_->_claimed >= reader_->_next + reader_->_window )
+                reader_->_consumed.wait( lock );
+            if( reader_->_stop || reader_->_claimed >= reader_->_numChunks )
+                return;
+            k = reader_->_claimed++;
+        }
+
+        const char *begin = _chunk_begin( reader_, k );
+        _parse_chunk( reader_, begin, _chunk_begin(reader_, k+1), chunk );
+        chunk._index = k;
+        chunk._offset = reader_->_base + (size_t)(begin - reader_->_begin);
+        {
+            std::lock_guard<std::mutex> lock( reader_->_mutex );
+            std::swap( reader_->_done[k], chunk );
+        }
+        reader_->_parsed.notify_all();
+    }
+}
+
+bool meerkat::mk_file_manager::start_chunks( const std::vector<int> &types_, int required_,
+                                             char separator_, int numThreads_ )
+{
+    if( _state != Read && _state != Mapped )
+    {
+        printf( "mk_file_manager warning: file is not open for read.\n" );
+        return false;
+    }
+    if( required_ < 0 || required_ > (int)types_.size() )
+    {
+        printf( "mk_file_manager warning: invalid number of required columns.\n" );
+        return false;
+    }
+    for( int c=0; c<(int)types_.size(); c++ )
+    {
+        if( types_[c] < Token || types_[c] > Real )
+        {
+            printf( "mk_file_manager warning: invalid column type.\n" );
+            return false;
+        }
+    }
+
+    stop_chunks();
+    _chunks = new __chunk_reader;
+    _chunks->_types = types_;
+    _chunks->_required = required_;
+    _chunks->_separator = separator_;
+    _chunks->_chunkSize = 1 << 22;
+    _chunks->_claimed = 0;
+    _chunks->_next = 0;
+    _chunks->_stop = false;
+    if( _state == Read )
+    {
+        // Chunks are read and parsed on demand
+        _chunks->_begin = _chunks->_end = NULL;
+        _chunks->_numChunks = 0;
+        _chunks->_window = 0;
+        return true;
+    }
+
+    // The rest of the mapped content is split into chunks and parsed by the workers
+    _chunks->_begin = _map + _cursor;
+    _chunks->_base = _cursor;
+    _chunks->_end = _map + _mapSize;
+    _chunks->_numChunks = (_mapSize - _cursor + _chunks->_chunkSize - 1) / _chunks->_chunkSize;
+    _cursor = _mapSize;
+    int numThreads = numThreads_ > 0 ? numThreads_ : (int)std::thread::hardware_concurrency();
+    if( numThreads < 1 )
+        numThreads = 1;
+    if( numThreads > (int)_chunks->_numChunks )
+        numThreads = (int)_chunks->_numChunks;
+    _chunks->_window = 2 * (size_t)numThreads;
+    for( int t=0; t<numThreads; t++ )
+        _chunks->_workers.push_back( std::thread(_chunk_worker, _chunks) );
+    return true;
+}
+
+bool meerkat::mk_file_manager::next_chunk( mk_chunk &chunk_ )
+{
+    if( _chunks == NULL )
+    {
+        printf( "mk_file_manager warning: chunked reading is not started.\n" );
+        return false;
+    }
+
+    if( _state == Mapped )
+    {
+        // Wait for the next chunk in order
+        std::unique_lock<std::mutex> lock( _chunks->_mutex );
+        if( _chunks->_next >= _chunks->_numChunks )
+            return false;
+        std::map<size_t, mk_chunk>::iterator it;
+        while( (it = _chunks->_done.find(_chunks->_next)) == _chunks->_done.end() )
+            _chunks->_parsed.wait( lock );
+        std::swap( chunk_, it->second );
+        _chunks->_done.erase( it );
+        _chunks->_next++;
+        lock.unlock();
+        _chunks->_consumed.notify_all();
+        return true;
+    }
+    else
+    {
+        // Copy lines into the text of the chunk, then parse
+        mk_line line;
+        chunk_._offset = offset();
+        chunk_._text.clear();
+        while( chunk_._text.size() < _chunks->_chunkSize && next_line(line) )
+        {
+            chunk_._text.insert( chunk_._text.end(), line._data, line._data + line._size );
+            chunk_._text.push_back( '\n' );
+        }
+        if( chunk_._text.empty() )
+            return false;
+        _parse_chunk( _chunks, &chunk_._text[0], &chunk_._text[0] + chunk_._text.size(), chunk_ );
+        chunk_._index = _chunks->_next++;
+        return true;
+    }
+}
+
+void meerkat::mk_file_manager::stop_chunks()
+{
+    if( _chunks == NULL )
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock( _chunks->_mutex );
+        _chunks->_stop = true;
+    }
+    _chunks->_consumed.notify_all();
+    for( int t=0; t<(int)_chunks->_workers.size(); t++ )
+        _chunks->_workers[t].join();
+    delete _chunks;
+    _chunks = NULL;
+}
+
+char *meerkat::mk_file_manager::_reserve( size_t size_ )
+{
+    if( _outSize + size_ > _out.size() )
+    {
+        if( _outSize > 0 && !_write_out() )
+        {
+            printf( "mk_file_manager warning: cannot write file (%s).\n", _fileName.c_str() );
+            _status = WriteFailed;
+        }
+        if( size_ > _out.size() )
+            _out.resize( size_ > (1 << 20) ? size_ : (1 << 20) );
+    }
+    return &_out[_outSize];
+}
+
+void meerkat::mk_file_manager::_format( double value_, char after_ )
+{
+    // Longest number is 24 characters (e.g., -2.2250738585072014e-308)
+    char *pos = _reserve( 32 ), *end;
+#if defined(__cpp_lib_to_chars)
+    if( _precision == 0 )
+        end = std::to_chars( pos, pos+31, value_ ).ptr;
+    else
+        end = std::to_chars( pos, pos+31, value_, std::chars_format::general, _precision ).ptr;
+#else
+    // Increase digits until the number reads back exactly
+    int digits = _precision > 0 ? _precision : 15;
+    end = pos + snprintf( pos, 32, "%.*g", digits, value_ );
+    while( _precision == 0 && digits < 17 && strtod(pos, NULL) != value_ )
+        end = pos + snprintf( pos, 32, "%.*g", ++digits, value_ );
+#endif
+    *end++ = after_;
+    _outSize += (size_t)(end - pos);
+}
+
+void meerkat::mk_file_manager::_put_row( const double *data_, int size_ )
+{
+    if( size_ == 0 )
+    {
+        *_reserve( 1 ) = '\n';
+        _outSize++;
+        return;
+    }
+    for( int i=0; i<size_; i++ )
+        _format( data_[i], i < size_-1 ? ' ' : '\n' );
+}
+
+bool meerkat::mk_file_manager::_write_out()
+{
+    if( _async == NULL )
+    {
+        bool written = _encode( _encoder, _pointer, &_out[0], _outSize, false );
+        _outSize = 0;
+        return written;
+    }
+
+    // Wait for a free block (back-pressure)
+    __async_writer *writer = _async;
+    size_t numBlocks = writer->_blocks.size();
+    size_t head = writer->_head.load( std::memory_order_relaxed );
+    if( head - writer->_tail.load(std::memory_order_acquire) == numBlocks )
+    {
+        std::unique_lock<std::mutex> lock( writer->_mutex );
+        while( head - writer->_tail.load(std::memory_order_acquire) == numBlocks )
+            writer->_written.wait( lock );
+    }
+
+    // Swap the output buffer with the free block and submit it
+    size_t slot = head % numBlocks;
+    std::swap( writer->_blocks[slot], _out );
+    writer->_sizes[slot] = _outSize;
+    _outSize = 0;
+    writer->_head.store( head+1, std::memory_order_release );
+    {
+        std::lock_guard<std::mutex> lock( writer->_mutex );
+    }
+    writer->_submitted.notify_one();
+    return !writer->_failed.load();
+}
+
+void meerkat::mk_file_manager::_async_worker( __async_writer *writer_ )
+{
+    size_t numBlocks = writer_->_blocks.size(), tail, slot;
+    while( true )
+    {
+        // Sleep while there is nothing to write
+        tail = writer_->_tail.load( std::memory_order_relaxed );
+        if( tail == writer_->_head.load(std::memory_order_acquire) )
+        {
+            std::unique_lock<std::mutex> lock( writer_->_mutex );
+            while( tail == writer_->_head.load(std::memory_order_acquire)
+                   && !writer_->_closing.load() )
+                writer_->_submitted.wait( lock );
+            if( tail == writer_->_head.load(std::memory_order_acquire) )
+                return;
+        }
+
+        // Write the oldest block
+        slot = tail % numBlocks;
+        if( !_encode(writer_->_encoder, writer_->_pointer, &writer_->_blocks[slot][0],
+                     writer_->_sizes[slot], false) )
+            writer_->_failed = true;
+        writer_->_tail.store( tail+1, std::memory_order_release );
+        {
+            std::lock_guard<std::mutex> lock( writer_->_mutex );
+        }
+        writer_->_written.notify_all();
+    }
+}
+
+void meerkat::mk_file_manager::_stop_async()
+{
+    if( _async == NULL )
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock( _async->_mutex );
+        _async->_closing = true;
+    }
+    _async->_submitted.notify_one();
+    _async->_thread.join();
+    delete _async;
+    _async = NULL;
+}
+
+void meerkat::mk_file_manager::_put_block()
+{
+    uint64_t rows = (uint64_t)_blockSize;
+    memcpy( _reserve(sizeof(uint64_t)), &rows, sizeof(uint64_t) );
+    _outSize += sizeof(uint64_t);
+    size_t size = _blockSize * sizeof(uint64_t);
+    for( int c=0; c<(int)_columnTypes.size(); c++ )
+    {
+        memcpy( _reserve(size), &_block[(size_t)c * _blockRows], size );
+        _outSize += size;
+    }
+    _blockSize = 0;
+}
+
+int meerkat::mk_file_manager::_codec_of( FILE *file_ )
+{
+    unsigned char magic[4] = {0, 0, 0, 0};
+    size_t len = fread( magic, 1, 4, file_ );
+    rewind( file_ );
+    if( len == 4 && memcmp(magic, "MKLZ", 4) == 0 )
+        return Lz;
+    if( len >= 2 && magic[0] == 0x1f && magic[1] == 0x8b )
+        return Gzip;
+    return Plain;
+}
+
+bool meerkat::mk_file_manager::_decode( FILE *source_, int codec_,
+                                        bool (*sink_)(const char*, size_t, void*),
+                                        void *context_ )
+{
+    if( codec_ == Lz )
+    {
+        // Magic, then blocks of compressed size, raw size and data until an empty block
+        char magic[4];
+        uint32_t sizes[2];
+        std::vector<char> packed, raw;
+        if( fread(magic, 1, 4, source_) != 4 || memcmp(magic, "MKLZ", 4) != 0 )
+            return false;
+        while( fread(sizes, sizeof(uint32_t), 2, source_) == 2 )
+        {
+            if( sizes[1] == 0 )
+                return true;
+            if( sizes[0] > sizes[1] || sizes[1] > (1u << 30) )
+                return false;
+            packed.resize( sizes[0] );
+            raw.resize( sizes[1] );
+            if( fread(&packed[0], 1, sizes[0], source_) != sizes[0] )
+                return false;
+            if( sizes[0] == sizes[1] )
+                raw.swap( packed );
+            else if( !_lz_decompress(&packed[0], sizes[0], &raw[0], sizes[1]) )
+                return false;
+            if( !sink_(&raw[0], sizes[1], context_) )
+                return false;
+        }
+        return false;
+    }
+#ifdef MEERKAT_ZLIB
+    else if( codec_ == Gzip )
+    {
+        // Inflate all members of the file
+        std::vector<unsigned char> in( 1 << 18 ), out( 1 << 18 );
+        z_stream stream;
+        memset( &stream, 0, sizeof(z_stream) );
+        if( inflateInit2(&stream, 15+32) != Z_OK )
+            return false;
+        int status = Z_OK;
+        bool complete = false;
+        while( true )
+        {
+            if( stream.avail_in == 0 )
+            {
+                stream.avail_in = (uInt)fread( &in[0], 1, in.size(), source_ );
+                stream.next_in = &in[0];
+                if( stream.avail_in == 0 )
+                    break;
+            }
+            stream.next_out = &out[0];
+            stream.avail_out = (uInt)out.size();
+            status = inflate( &stream, Z_NO_FLUSH );
+            if( status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR )
+                break;
+            if( stream.avail_out < out.size()
+                    && !sink_((const char*)&out[0], out.size() - stream.avail_out, context_) )
+                break;
+            complete = status == Z_STREAM_END;
+            if( complete )
+                inflateReset( &stream );
+        }
+        inflateEnd( &stream );
+        return complete;
+    }
+#endif
+    return false;
+}
+
+bool meerkat::mk_file_manager::_encode( __encoder *encoder_, FILE *file_, const char *data_,
+                                        size_t size_, bool finish_ )
+{
+    if( encoder_ == NULL )
+        return size_ == 0 || fwrite( data_, 1, size_, file_ ) == size_;
+
+    if( encoder_->_codec == Lz )
+    {
+        // Compressed block (raw if it does not compress), empty block at the end
+        uint32_t sizes[2] = {0, 0};
+        bool written = true;
+        if( size_ > 0 )
+        {
+            encoder_->_buffer.resize( size_ + size_/255 + 16 );
+            size_t packed = _lz_compress( data_, size_, &encoder_->_buffer[0],
+                                          &encoder_->_table[0] );
+            const char *block = packed < size_ ? &encoder_->_buffer[0] : data_;
+            sizes[0] = (uint32_t)(packed < size_ ? packed : size_);
+            sizes[1] = (uint32_t)size_;
+            written = fwrite( sizes, sizeof(uint32_t), 2, file_ ) == 2
+                    && fwrite( block, 1, sizes[0], file_ ) == sizes[0];
+        }
+        if( finish_ )
+        {
+            sizes[0] = sizes[1] = 0;
+            written = fwrite( sizes, sizeof(uint32_t), 2, file_ ) == 2 && written;
+        }
+        return written;
+    }
+#ifdef MEERKAT_ZLIB
+    else if( encoder_->_codec == Gzip )
+    {
+        z_stream *stream = (z_stream*)encoder_->_stream;
+        encoder_->_buffer.resize( 1 << 18 );
+        stream->next_in = (Bytef*)data_;
+        stream->avail_in = (uInt)size_;
+        int status;
+        size_t produced;
+        bool written = true;
+        do
+        {
+            stream->next_out = (Bytef*)&encoder_->_buffer[0];
+            stream->avail_out = (uInt)encoder_->_buffer.size();
+            status = deflate( stream, finish_ ? Z_FINISH : Z_NO_FLUSH );
+            produced = encoder_->_buffer.size() - stream->avail_out;
+            if( produced > 0 && fwrite(&encoder_->_buffer[0], 1, produced, file_) != produced )
+                written = false;
+        } while( status == Z_OK && (stream->avail_out == 0 || (finish_ && status != Z_STREAM_END)) );
+        if( finish_ )
+        {
+            deflateEnd( stream );
+            delete stream;
+            encoder_->_stream = NULL;
+        }
+        return written && status != Z_STREAM_ERROR;
+    }
+#endif
+    return false;
+}
+
+size_t meerkat::mk_file_manager::_lz_compress( const char *source_, size_t size_,
+                                               char *destination_, uint32_t *table_ )
+{
+    const unsigned char *begin = (const unsigned char*)source_, *end = begin + size_;
+    const unsigned char *pos = begin, *anchor = begin, *ref, *m, *r;
+    const unsigned char *matchLimit = size_ > 12 ? end - 12 : begin;
+    unsigned char *out = (unsigned char*)destination_, *token;
+    uint32_t sequence, hash;
+    size_t literals, length, offset, misses = 0;
+    memset( table_, 0, sizeof(uint32_t) << 16 );
+    while( pos < matchLimit )
+    {
+        // Candidate with the same first 4 bytes within 64 kB
+        memcpy( &sequence, pos, 4 );
+        hash = (sequence * 2654435761u) >> 16;
+        ref = begin + table_[hash];
+        table_[hash] = (uint32_t)(pos - begin);
+        if( ref >= pos || pos - ref > 65535 || memcmp(ref, pos, 4) != 0 )
+        {
+            // Skip faster through incompressible data
+            pos += 1 + (misses++ >> 6);
+            continue;
+        }
+        misses = 0;
+
+        // Extend the match, keeping the last 5 bytes as literals
+        m = pos + 4;
+        r = ref + 4;
+        while( m < end - 5 && *m == *r )
+        {
+            m++;
+            r++;
+        }
+
+        // Token, literals, offset and match length
+        token = out++;
+        literals = (size_t)(pos - anchor);
+        if( literals >= 15 )
+        {
+            *token = 15 << 4;
+            for( length = literals - 15; length >= 255; length -= 255 )
+                *out++ = 255;
+            *out++ = (unsigned char)length;
+        }
+        else
+            *token = (unsigned char)(literals << 4);
+        memcpy( out, anchor, literals );
+        out += literals;
+        offset = (size_t)(pos - ref);
+        *out++ = (unsigned char)(offset & 255);
+        *out++ = (unsigned char)(offset >> 8);
+        length = (size_t)(m - pos) - 4;
+        if( length >= 15 )
+        {
+            *token |= 15;
+            for( length -= 15; length >= 255; length -= 255 )
+                *out++ = 255;
+            *out++ = (unsigned char)length;
+        }
+        else
+            *token |= (unsigned char)length;
+        pos = anchor = m;
+    }
+
+    // Last literals
+    token = out++;
+    literals = (size_t)(end - anchor);
+    if( literals >= 15 )
+    {
+        *token = 15 << 4;
+        for( length = literals - 15; length >= 255; length -= 255 )
+            *out++ = 255;
+        *out++ = (unsigned char)length;
+    }
+    else
+        *token = (unsigned char)(literals << 4);
+    memcpy( out, anchor, literals );
+    out += literals;
+    return (size_t)(out - (unsigned char*)destination_);
+}
+
+bool meerkat::mk_file_manager::_lz_decompress( const char *source_, size_t size_,
+                                               char *destination_, size_t rawSize_ )
+{
+    const unsigned char *in = (const unsigned char*)source_, *inEnd = in + size_;
+    unsigned char *out = (unsigned char*)destination_, *outEnd = out + rawSize_;
+    const unsigned char *match;
+    unsigned char token, b;
+    size_t length, offset;
+    while( in < inEnd )
+    {
+        // Literals
+        token = *in++;
+        length = token >> 4;
+        if( length == 15 )
+        {
+            do
+            {
+                if( in >= inEnd )
+                    return false;
+                b = *in++;
+                length += b;
+            } while( b == 255 );
+        }
+        if( length > (size_t)(inEnd - in) || length > (size_t)(outEnd - out) )
+            return false;
+        memcpy( out, in, length );
+        in += length;
+        out += length;
+        if( in == inEnd )
+            break;
+
+        // Match
+        if( inEnd - in < 2 )
+            return false;
+        offset = (size_t)in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        if( offset == 0 || offset > (size_t)(out - (unsigned char*)destination_) )
+            return false;
+        length = token & 15;
+        if( length == 15 )
+        {
+            do
+            {
+                if( in >= inEnd )
+                    return false;
+                b = *in++;
+                length += b;
+            } while( b == 255 );
+        }
+        length += 4;
+        if( length > (size_t)(outEnd - out) )
+            return false;
+        match = out - offset;
+        if( offset >= length )
+            memcpy( out, match, length );
+        else
+        {
+            for( size_t i=0; i<length; i++ )
+                out[i] = match[i];
+        }
+        out += length;
+    }
+    return out == outEnd;
+}
+
+bool meerkat::mk_file_manager::_pipe_sink( const char *data_, size_t size_, void *decoder_ )
+{
+    __decoder *decoder = (__decoder*)decoder_;
+    ssize_t written;
+    while( size_ > 0 )
+    {
+        if( decoder->_stop.load() )
+            return false;
+        written = ::write( decoder->_pipe, data_, size_ < 65536 ? size_ : 65536 );
+        if( written < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            return false;
+        }
+        data_ += written;
+        size_ -= (size_t)written;
+    }
+    return true;
+}
+
+void meerkat::mk_file_manager::_decode_worker( __decoder *decoder_ )
+{
+    if( !_decode(decoder_->_source, decoder_->_codec, _pipe_sink, decoder_)
+            && !decoder_->_stop.load() )
+        decoder_->_failed = true;
+    ::close( decoder_->_pipe );
+}
+
+bool meerkat::mk_file_manager::_start_decoder( FILE *source_, int codec_ )
+{
+#ifndef MEERKAT_ZLIB
+    if( codec_ == Gzip )
+    {
+        printf( "mk_file_manager warning: gzip needs MEERKAT_ZLIB (%s).\n", _fileName.c_str() );
+        fclose( source_ );
+        return false;
+    }
+#endif
+    int fds[2];
+    if( pipe(fds) != 0 )
+    {
+        fclose( source_ );
+        return false;
+    }
+    _pointer = fdopen( fds[0], "r" );
+    _decoder = new __decoder;
+    _decoder->_codec = codec_;
+    _decoder->_source = source_;
+    _decoder->_pipe = fds[1];
+    _decoder->_stop = false;
+    _decoder->_failed = false;
+    _decoder->_thread = std::thread( _decode_worker, _decoder );
+    return true;
+}
+
+void meerkat::mk_file_manager::_stop_decoder()
+{
+    if( _decoder == NULL )
+        return;
+
+    // Drain the pipe so that the decompressing thread does not block
+    char block[65536];
+    _decoder->_stop = true;
+    while( fread(block, 1, sizeof(block), _pointer) > 0 )
+        ;
+    _decoder->_thread.join();
+    fclose( _pointer );
+    _pointer = NULL;
+    fclose( _decoder->_source );
+    delete _decoder;
+    _decoder = NULL;
+}
+
+void meerkat::mk_file_manager::_stop_encoder()
+{
+    if( _encoder == NULL )
+        return;
+
+    if( !_encode(_encoder, _pointer, NULL, 0, true) )
+    {
+        printf( "mk_file_manager warning: cannot write file (%s).\n", _fileName.c_str() );
+        _status = WriteFailed;
+    }
+    delete _encoder;
+    _encoder = NULL;
+}
+
+long meerkat::mk_file_manager::_read_line()
+{
+    ssize_t len = getline( &_line, &_lineCapacity, _pointer );
+    if( len >= 0 )
+    {
+        _offset += (size_t)len;
+        return (long)len;
+    }
+
+    // End of file or failure, reported once
+    if( _status != Ok )
+        return -1;
+    if( ferror(_pointer) )
+        _error( "cannot read file", ReadFailed );
+    else if( _decoder != NULL && _decoder->_failed.load() )
+        _error( "compressed file is corrupt or truncated", Corrupt );
+    return -1;
+}
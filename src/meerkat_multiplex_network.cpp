@@ -0,0 +1,254 @@
+#include "meerkat_multiplex_network.hpp"
+
+
+bool meerkat::mk_multiplex_network::_is_node_id_valid( int nodeId_ ) const
+{
+    return (nodeId_ >= 0 && nodeId_ < order());
+}
+
+meerkat::mk_multiplex_network::mk_multiplex_network()
+{
+    _compact = false;
+    _directed = false;
+    _log.tag( "mk_multiplex_network" );
+}
+
+meerkat::mk_multiplex_network::~mk_multiplex_network()
+{
+    destroy();
+}
+
+void meerkat::mk_multiplex_network::set_compact( bool compact_ )
+{
+    _compact = compact_;
+}
+
+void meerkat::mk_multiplex_network::set_directed( bool directed_ )
+{
+    _directed = directed_;
+}
+
+bool meerkat::mk_multiplex_network::create( const std::vector<std::string> &filenames_,
+                                            bool reverseTime_ )
+{
+    if( layers() > 0 )
+    {
+        _log.w( "create", "network is already created" );
+        return false;
+    }
+
+    /// Read the contacts of each layer over the shared label table
+    int numLayers = (int)filenames_.size();
+    mk_temporal_network *layer;
+    for( int l=0; l<numLayers; l++ )
+    {
+        mk_file_manager fm;
+        layer = new mk_temporal_network();
+        layer->set_compact( _compact );
+        layer->set_directed( _directed );
+        layer->_share_labels( &_labels );
+        _layers.push_back( layer );
+        if( !fm.map(filenames_[l]) )
+        {
+            _log.e( "create", "no such file: '%s'", filenames_[l].c_str() );
+            destroy();
+            return false;
+        }
+        if( !layer->_read_contacts(fm, true) )
+        {
+            _log.e( "create", "no valid contacts in '%s'", filenames_[l].c_str() );
+            destroy();
+            return false;
+        }
+    }
+
+    /// Determine common time frame
+    unsigned long startTimestamp = ULONG_MAX, endTimestamp = 0, timeWindow = ULONG_MAX;
+    for( int l=0; l<numLayers; l++ )
+    {
+        const mk_temporal_network::__pending &pending = _layers[l]->_pending;
+        if( pending._start < startTimestamp )
+            startTimestamp = pending._start;
+        if( pending._end > endTimestamp )
+            endTimestamp = pending._end;
+        if( pending._window < timeWindow )
+            timeWindow = pending._window;
+    }
+
+    /// Build the edges of the layers in the common frame
+    for( int l=0; l<numLayers; l++ )
+    {
+        _layers[l]->_set_frame( startTimestamp, endTimestamp, timeWindow );
+        if( !_layers[l]->_build_edges(reverseTime_) )
+        {
+            destroy();
+            return false;
+        }
+    }
+
+    /// Add nodes of other layers to each layer
+    for( int l=0; l<numLayers; l++ )
+        _layers[l]->_sync_nodes();
+    _log.i( "create", "number of layers:  %i", layers() );
+    _log.i( "create", "number of nodes:   %i", order() );
+
+    /// Init time
+    set_clock( 0 );
+    return true;
+}
+
+bool meerkat::mk_multiplex_network::destroy()
+{
+    int numLayers = layers();
+    if( numLayers > 0 )
+    {
+        for( int l=0; l<numLayers; l++ )
+            delete _layers[l];
+        _layers.clear();
+        _labels._labels.clear();
+        _labels._hash.clear();
+        _log.i( "destroy", "network is destroyed" );
+        return true;
+    }
+    else
+        return false;
+}
+
+const meerkat::mk_temporal_network *meerkat::mk_multiplex_network::layer( int layerId_ ) const
+{
+    // Check layer id
+    if( layerId_ >= 0 && layerId_ < layers() )
+        return _layers[layerId_];
+    else
+    {
+        _log.w( "layer", "invalid layer id" );
+        return NULL;
+    }
+}
+
+const std::string *meerkat::mk_multiplex_network::label( int nodeId_ ) const
+{
+    // Check node id
+    if( _is_node_id_valid(nodeId_) )
+        return &_labels._labels[nodeId_];
+    else
+    {
+        _log.w( "label", "invalid node id" );
+        return NULL;
+    }
+}
+
+int meerkat::mk_multiplex_network::node_id( std::string label_ ) const
+{
+    if( _labels._hash.find(label_) != _labels._hash.end() )
+        return _labels._hash.at(label_);
+    else
+        return -1;
+}
+
+int meerkat::mk_multiplex_network::active_degree( int nodeId_ ) const
+{
+    // Check node id
+    if( !_is_node_id_valid(nodeId_) )
+    {
+        _log.w( "active_degree", "invalid node id" );
+        return 0;
+    }
+
+    int numLayers = layers(), d = 0;
+    for( int l=0; l<numLayers; l++ )
+        d += _layers[l]->active_degree( nodeId_ );
+    return d;
+}
+
+int meerkat::mk_multiplex_network::active_neighbor( int nodeId_, int neighborId_,
+                                                    int *layerId_ ) const
+{
+    // Check node id
+    if( !_is_node_id_valid(nodeId_) )
+    {
+        _log.w( "active_neighbor", "invalid node id" );
+        return -1;
+    }
+
+    // Find layer of the neighbor
+    int numLayers = layers(), deg;
+    if( neighborId_ >= 0 )
+    {
+        for( int l=0; l<numLayers; l++ )
+        {
+            deg = _layers[l]->active_degree( nodeId_ );
+            if( neighborId_ < deg )
+            {
+                if( layerId_ != NULL )
+                    *layerId_ = l;
+                return _layers[l]->active_neighbor( nodeId_, neighborId_ );
+            }
+            neighborId_ -= deg;
+        }
+    }
+
+    _log.w( "active_neighbor", "invalid neighbor id" );
+    return -1;
+}
+
+void meerkat::mk_multiplex_network::active_neighbors( int nodeId_,
+                                                      std::vector<int> &neighbors_ ) const
+{
+    neighbors_.clear();
+    if( !_is_node_id_valid(nodeId_) )
+    {
+        _log.w( "active_neighbors", "invalid node id" );
+        return;
+    }
+
+    // Collect neighbors of all layers and remove duplicates
+    int numLayers = layers(), deg;
+    for( int l=0; l<numLayers; l++ )
+    {
+        deg = _layers[l]->active_degree( nodeId_ );
+        for( int j=0; j<deg; j++ )
+            neighbors_.push_back( _layers[l]->active_neighbor(nodeId_, j) );
+    }
+    std::sort( neighbors_.begin(), neighbors_.end() );
+    neighbors_.erase( std::unique(neighbors_.begin(), neighbors_.end()), neighbors_.end() );
+}
+
+int meerkat::mk_multiplex_network::layers() const
+{
+    return (int)_layers.size();
+}
+
+int meerkat::mk_multiplex_network::order() const
+{
+    return (int)_labels._labels.size();
+}
+
+int meerkat::mk_multiplex_network::time() const
+{
+    return layers() > 0 ? _layers[0]->time() : 0;
+}
+
+int meerkat::mk_multiplex_network::maxTime() const
+{
+    return layers() > 0 ? _layers[0]->maxTime() : 0;
+}
+
+int meerkat::mk_multiplex_network::time_window() const
+{
+    return layers() > 0 ? _layers[0]->time_window() : 0;
+}
+
+void meerkat::mk_multiplex_network::set_clock( const int time_ )
+{
+    int numLayers = layers();
+    for( int l=0; l<numLayers; l++ )
+        _layers[l]->set_clock( time_ );
+}
+
+void meerkat::mk_multiplex_network::update_clock()
+{
+    int numLayers = layers();
+    for( int l=0; l<numLayers; l++ )
+        _layers[l]->update_clock();
+}
@@ -1,35 +1,292 @@
 #include "meerkat_random_generator.hpp"
 
 
+// ziggurat tables: layer boundaries x[i] (decreasing, x[1] = R, x[N] = 0), scaled to 53-bit
+// uniforms in w[i], and density values f[i] = f(x[i])
+struct __ziggurat
+{
+    double _normalW[128], _normalX[129], _normalF[129];
+    double _expW[256], _expX[257], _expF[257];
+
+    __ziggurat()
+    {
+        const double scale = 1.0/9007199254740992.0;
+
+        // normal: 128 layers, f(x) = exp(-x^2/2)
+        double r = 3.442619855899, v = 9.91256303526217e-3;
+        _normalX[0] = v / exp( -0.5*r*r );
+        _normalX[1] = r;
+        for(int i=2; i<128; i++)
+            _normalX[i] = sqrt( -2.0*log(v/_normalX[i-1] + exp(-0.5*_normalX[i-1]*_normalX[i-1])) );
+        _normalX[128] = 0.0;
+        for(int i=0; i<=128; i++)
+            _normalF[i] = exp( -0.5*_normalX[i]*_normalX[i] );
+        for(int i=0; i<128; i++)
+            _normalW[i] = _normalX[i] * scale;
+
+        // exponential: 256 layers, f(x) = exp(-x)
+        r = 7.69711747013104972;
+        v = 3.949659822581572e-3;
+        _expX[0] = v / exp( -r );
+        _expX[1] = r;
+        for(int i=2; i<256; i++)
+            _expX[i] = -log( v/_expX[i-1] + exp(-_expX[i-1]) );
+        _expX[256] = 0.0;
+        for(int i=0; i<=256; i++)
+            _expF[i] = exp( -_expX[i] );
+        for(int i=0; i<256; i++)
+            _expW[i] = _expX[i] * scale;
+    }
+};
+
+static const __ziggurat &ziggurat()
+{
+    static const __ziggurat tables;
+    return tables;
+}
+
+
 meerkat::mk_random_generator::mk_random_generator()
 {
-    _a._isTableSet = false;
-    srand( time(NULL) );
-    init( rand()%10000 );
+    _engine = MotherOfAll;
+
+    // mix entropy source, time and address into a 64-bit seed
+    std::random_device device;
+    uint64_t sm = ((uint64_t)device() << 32) ^ (uint64_t)device();
+    sm ^= (uint64_t)time(NULL) * 0x9e3779b97f4a7c15ULL;
+    sm ^= (uint64_t)clock() + (uint64_t)(uintptr_t)this;
+    init_stream( _splitmix64(sm), 0 );
 }
 
 meerkat::mk_random_generator::mk_random_generator( int seed_ )
 {
-    _a._isTableSet = false;
+    _engine = MotherOfAll;
     init( seed_ );
 }
 
+meerkat::mk_random_generator::mk_random_generator( int seed_, Engine engine_ )
+{
+    _engine = engine_;
+    init( seed_ );
+}
+
+meerkat::mk_random_generator::mk_random_generator( uint64_t seed_, uint64_t stream_,
+                                                   Engine engine_ )
+{
+    _engine = engine_;
+    init_stream( seed_, stream_ );
+}
+
 void meerkat::mk_random_generator::init( int seed_ )
 {
-    uint32_t s = (uint32_t)seed_;
-    // make random numbers and put them into the buffer
-    for(int i=0; i<5; i++)
+    init_stream( (uint64_t)(uint32_t)seed_, 0 );
+}
+
+void meerkat::mk_random_generator::init_stream( uint64_t seed_, uint64_t stream_ )
+{
+    _seed = seed_;
+    _stream = stream_;
+    _seed_engine();
+    _seed_lanes();
+}
+
+void meerkat::mk_random_generator::_seed_engine()
+{
+    switch( _engine )
+    {
+    case Xoshiro256:
+    {
+        // fill state with splitmix64 outputs, streams are separated by jumps
+        uint64_t sm = _seed;
+        for(int i=0; i<4; i++)
+            _s[i] = _splitmix64( sm );
+        for(uint64_t j=0; j<_stream; j++)
+            _xoshiro_jump( _s, false );
+        break;
+    }
+    case Pcg64:
+    {
+        // seed state and sequence with splitmix64 outputs as in pcg_setseq_128_srandom_r,
+        // streams have distinct sequences (increments)
+        uint64_t sm = _seed;
+        uint64_t initState[2], initSeq[2];
+        initState[0] = _splitmix64( sm );
+        initState[1] = _splitmix64( sm );
+        initSeq[0] = _splitmix64( sm );
+        initSeq[1] = _splitmix64( sm );
+        __uint128_t seq = (((__uint128_t)initSeq[0] << 64) | initSeq[1]) + _stream;
+        __uint128_t inc = (seq << 1) | 1u;
+        _pcg[0] = 0;
+        _pcg[1] = 0;
+        _pcg[2] = (uint64_t)(inc >> 64);
+        _pcg[3] = (uint64_t)inc;
+        _random_bits64();
+        __uint128_t state = (((__uint128_t)_pcg[0] << 64) | _pcg[1])
+                + (((__uint128_t)initState[0] << 64) | initState[1]);
+        _pcg[0] = (uint64_t)(state >> 64);
+        _pcg[1] = (uint64_t)state;
+        _random_bits64();
+        break;
+    }
+    case Philox:
+    {
+        // key from the seed and stream, counter starts at zero
+        uint64_t sm = _seed + _stream * 0x9e3779b97f4a7c15ULL;
+        uint64_t key = _splitmix64( sm );
+        _philox[0] = (uint32_t)key;
+        _philox[1] = (uint32_t)(key >> 32);
+        set_counter( 0, 0, 0 );
+        break;
+    }
+    default:
+    {
+        uint64_t sm = _seed + _stream * 0x9e3779b97f4a7c15ULL;
+        uint32_t s = _stream == 0 ? (uint32_t)_seed : (uint32_t)_splitmix64( sm );
+        // make random numbers and put them into the buffer
+        for(int i=0; i<5; i++)
+        {
+            s = 29943829*s - 1;
+            _x[i] = s;
+        }
+        // randomize some more
+        for(int i=0; i<19; i++)
+            _random_bits();
+        break;
+    }
+    }
+}
+
+void meerkat::mk_random_generator::create_streams( uint64_t seed_, int numStreams_,
+                                                   Engine engine_,
+                                                   std::vector<mk_random_generator> &streams_ )
+{
+    streams_.clear();
+    if( numStreams_ <= 0 )
+        return;
+
+    // jump from the previous stream instead of seeding each from scratch
+    streams_.reserve( numStreams_ );
+    streams_.push_back( mk_random_generator(seed_, 0, engine_) );
+    for(int i=1; i<numStreams_; i++)
     {
-        s = 29943829*s - 1;
-        _x[i] = s;
+        mk_random_generator next = streams_.back();
+        next._stream = i;
+        if( engine_ == Xoshiro256 )
+            next.jump();
+        else
+            next._seed_engine();
+        if( engine_ != Philox )
+        {
+            for(int l=0; l<4; l++)
+            {
+                // lanes are stored word-major, jump each lane separately
+                uint64_t state[4];
+                for(int w=0; w<4; w++)
+                    state[w] = streams_.back()._lanes[4*w + l];
+                _xoshiro_jump( state, true );
+                for(int w=0; w<4; w++)
+                    next._lanes[4*w + l] = state[w];
+            }
+        }
+        streams_.push_back( next );
     }
-    // randomize some more
-    for(int i=0; i<19; i++)
-        _random_bits();
+}
+
+void meerkat::mk_random_generator::set_counter( uint32_t a_, uint32_t b_, uint32_t c_ )
+{
+    // first word counts the blocks drawn with the given counter
+    _philox[2] = 0;
+    _philox[3] = a_;
+    _philox[4] = b_;
+    _philox[5] = c_;
+    _philoxIndex = 2;
+}
+
+void meerkat::mk_random_generator::jump()
+{
+    switch( _engine )
+    {
+    case Xoshiro256:
+        _xoshiro_jump( _s, false );
+        break;
+    case Pcg64:
+        _pcg_advance( 1, 0 );
+        break;
+    default:
+        printf( "meerkat_random_generator warning: jump is not supported by the engine.\n" );
+        break;
+    }
+}
+
+void meerkat::mk_random_generator::long_jump()
+{
+    switch( _engine )
+    {
+    case Xoshiro256:
+        _xoshiro_jump( _s, true );
+        break;
+    case Pcg64:
+        _pcg_advance( (uint64_t)1 << 32, 0 );
+        break;
+    default:
+        printf( "meerkat_random_generator warning: jump is not supported by the engine.\n" );
+        break;
+    }
+}
+
+void meerkat::mk_random_generator::_pcg_advance( uint64_t deltaHigh_, uint64_t deltaLow_ )
+{
+    // LCG jump ahead in O(log delta), as pcg_advance_lcg_128
+    __uint128_t delta = ((__uint128_t)deltaHigh_ << 64) | deltaLow_;
+    __uint128_t curMult = ((__uint128_t)2549297995355413924ULL << 64) + 4865540595714422341ULL;
+    __uint128_t curPlus = ((__uint128_t)_pcg[2] << 64) | _pcg[3];
+    __uint128_t accMult = 1u, accPlus = 0u;
+    while( delta > 0 )
+    {
+        if( delta & 1u )
+        {
+            accMult *= curMult;
+            accPlus = accPlus * curMult + curPlus;
+        }
+        curPlus = (curMult + 1) * curPlus;
+        curMult *= curMult;
+        delta >>= 1;
+    }
+    __uint128_t state = accMult * ((((__uint128_t)_pcg[0] << 64) | _pcg[1])) + accPlus;
+    _pcg[0] = (uint64_t)(state >> 64);
+    _pcg[1] = (uint64_t)state;
+}
+
+void meerkat::mk_random_generator::set_engine( Engine engine_ )
+{
+    _engine = engine_;
+    init_stream( _seed, _stream );
+}
+
+meerkat::mk_random_generator::Engine meerkat::mk_random_generator::engine() const
+{
+    return _engine;
+}
+
+uint64_t meerkat::mk_random_generator::bits64()
+{
+    return _random_bits64();
+}
+
+uint64_t meerkat::mk_random_generator::_splitmix64( uint64_t &state_ )
+{
+    uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
 }
 
 uint32_t meerkat::mk_random_generator::_random_bits()
 {
+    // 64-bit engines: take the high (best quality) bits
+    if( _engine != MotherOfAll )
+        return (uint32_t)(_random_bits64() >> 32);
+
     uint64_t sum;
     sum = (uint64_t)2111111111UL * (uint64_t)_x[3] +
             (uint64_t)1492 * (uint64_t)(_x[2]) +
@@ -44,9 +301,422 @@ uint32_t meerkat::mk_random_generator::_random_bits()
     return _x[0];
 }
 
+uint64_t meerkat::mk_random_generator::_random_bits64()
+{
+    switch( _engine )
+    {
+    case Xoshiro256:
+    {
+        uint64_t x = _s[1] * 5;
+        const uint64_t result = ((x << 7) | (x >> 57)) * 9;
+        const uint64_t t = _s[1] << 17;
+        _s[2] ^= _s[0];
+        _s[3] ^= _s[1];
+        _s[1] ^= _s[2];
+        _s[0] ^= _s[3];
+        _s[2] ^= t;
+        _s[3] = (_s[3] << 45) | (_s[3] >> 19);
+        return result;
+    }
+    case Pcg64:
+    {
+        const __uint128_t multiplier = ((__uint128_t)2549297995355413924ULL << 64)
+                + 4865540595714422341ULL;
+        __uint128_t state = ((__uint128_t)_pcg[0] << 64) | _pcg[1];
+        state = state * multiplier + (((__uint128_t)_pcg[2] << 64) | _pcg[3]);
+        _pcg[0] = (uint64_t)(state >> 64);
+        _pcg[1] = (uint64_t)state;
+        uint64_t xored = _pcg[0] ^ _pcg[1];
+        unsigned int rot = (unsigned int)(_pcg[0] >> 58);
+        return (xored >> rot) | (xored << ((64 - rot) & 63));
+    }
+    case Philox:
+    {
+        if( _philoxIndex == 2 )
+        {
+            uint32_t out[4];
+            _philox_block( _philox+2, _philox, out );
+            _philox[2]++;
+            _philoxOut[0] = ((uint64_t)out[0] << 32) | out[1];
+            _philoxOut[1] = ((uint64_t)out[2] << 32) | out[3];
+            _philoxIndex = 0;
+        }
+        return _philoxOut[_philoxIndex++];
+    }
+    default:
+    {
+        uint64_t hi = _random_bits();
+        return (hi << 32) | _random_bits();
+    }
+    }
+}
+
+void meerkat::mk_random_generator::_xoshiro_jump( uint64_t *state_, bool long_ )
+{
+    static const uint64_t JUMP[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                    0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+    static const uint64_t LONG_JUMP[] = {0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+                                         0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+    const uint64_t *jump = long_ ? LONG_JUMP : JUMP;
+    uint64_t s[4] = {0, 0, 0, 0}, x, t;
+    for(int i=0; i<4; i++)
+    {
+        for(int b=0; b<64; b++)
+        {
+            if( jump[i] & ((uint64_t)1 << b) )
+            {
+                for(int w=0; w<4; w++)
+                    s[w] ^= state_[w];
+            }
+
+            // step state
+            x = state_[1] << 17;
+            state_[2] ^= state_[0];
+            state_[3] ^= state_[1];
+            state_[1] ^= state_[2];
+            state_[0] ^= state_[3];
+            state_[2] ^= x;
+            t = state_[3];
+            state_[3] = (t << 45) | (t >> 19);
+        }
+    }
+    for(int w=0; w<4; w++)
+        state_[w] = s[w];
+}
+
+int meerkat::mk_random_generator::_poisson_ptrs( double lambda_ )
+{
+    double slam = sqrt( lambda_ );
+    double loglam = log( lambda_ );
+    double b = 0.931 + 2.53*slam;
+    double a = -0.059 + 0.02483*b;
+    double invalpha = 1.1239 + 1.1328/(b-3.4);
+    double vr = 0.9277 - 3.6224/(b-2.0);
+    double u, v, us, k;
+    while( true )
+    {
+        u = _random_double() - 0.5;
+        v = (double)((_random_bits64() >> 11) + 1) * (1.0/9007199254740992.0);
+        us = 0.5 - fabs(u);
+        k = floor( (2.0*a/us + b)*u + lambda_ + 0.43 );
+
+        // squeeze
+        if( us >= 0.07 && v <= vr )
+            return (int)k;
+        if( k < 0.0 || (us < 0.013 && v > us) )
+            continue;
+
+        // acceptance
+        if( log(v) + log(invalpha) - log(a/(us*us) + b) <= -lambda_ + k*loglam - lgamma(k+1.0) )
+            return (int)k;
+    }
+}
+
+int meerkat::mk_random_generator::_binomial_inversion( int n_, double p_ )
+{
+    // sequential search from zero, expected n*p steps
+    double q = 1.0 - p_;
+    double s = p_ / q;
+    double a = (n_+1) * s;
+    double r = pow( q, (double)n_ );
+    double u = _random_double();
+    int k = 0;
+    while( u > r && k < n_ )
+    {
+        u -= r;
+        k++;
+        r *= a/k - s;
+    }
+    return k;
+}
+
+int meerkat::mk_random_generator::_binomial_btrs( int n_, double p_ )
+{
+    double q = 1.0 - p_;
+    double spq = sqrt( n_*p_*q );
+    double b = 1.15 + 2.53*spq;
+    double a = -0.0873 + 0.0248*b + 0.01*p_;
+    double c = n_*p_ + 0.5;
+    double vr = 0.92 - 4.2/b;
+    double alpha = (2.83 + 5.1/b) * spq;
+    double lpq = log( p_/q );
+    double m = floor( (n_+1)*p_ );
+    double h = lgamma( m+1.0 ) + lgamma( n_-m+1.0 );
+    double u, v, us, k;
+    while( true )
+    {
+        u = _random_double() - 0.5;
+        v = (double)((_random_bits64() >> 11) + 1) * (1.0/9007199254740992.0);
+        us = 0.5 - fabs(u);
+        k = floor( (2.0*a/us + b)*u + c );
+        if( k < 0.0 || k > n_ )
+            continue;
+
+        // squeeze
+        if( us >= 0.07 && v <= vr )
+            return (int)k;
+
+        // acceptance
+        v = log( v*alpha/(a/(us*us) + b) );
+        if( v <= h - lgamma(k+1.0) - lgamma(n_-k+1.0) + (k-m)*lpq )
+            return (int)k;
+    }
+}
+
+void meerkat::mk_random_generator::_philox_block( const uint32_t *counter_, const uint32_t *key_,
+                                                  uint32_t *out_ )
+{
+    uint32_t c0 = counter_[0], c1 = counter_[1], c2 = counter_[2], c3 = counter_[3];
+    uint32_t k0 = key_[0], k1 = key_[1];
+    uint64_t p0, p1;
+    for(int r=0; r<10; r++)
+    {
+        p0 = (uint64_t)0xD2511F53 * c0;
+        p1 = (uint64_t)0xCD9E8D57 * c2;
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+    }
+    out_[0] = c0;
+    out_[1] = c1;
+    out_[2] = c2;
+    out_[3] = c3;
+}
+
+void meerkat::mk_random_generator::_philox_bits( uint64_t *data_, int n_ )
+{
+    // use up the current block
+    int i = 0;
+    while( i < n_ && _philoxIndex < 2 )
+        data_[i++] = _philoxOut[_philoxIndex++];
+
+    // full blocks in batches of 16 consecutive counters
+    uint64_t out[32];
+    int batch;
+#ifdef MEERKAT_RANDOM_GENERATOR_AVX2
+    static const bool hasAvx2 = __builtin_cpu_supports( "avx2" );
+#endif
+    while( n_ - i >= 2 )
+    {
+#ifdef MEERKAT_RANDOM_GENERATOR_AVX2
+        if( hasAvx2 )
+            _philox_batch_avx2( _philox, out );
+        else
+#endif
+        _philox_batch_scalar( _philox, out );
+        batch = (n_ - i) / 2 < 16 ? (n_ - i) / 2 : 16;
+        for(int j=0; j<2*batch; j++)
+            data_[i++] = out[j];
+        _philox[2] += (uint32_t)batch;
+    }
+
+    // last element from a new block, keep the rest
+    if( i < n_ )
+        data_[i] = _random_bits64();
+}
+
+void meerkat::mk_random_generator::_philox_batch_scalar( const uint32_t *philox_, uint64_t *out_ )
+{
+    uint32_t counter[4] = {philox_[2], philox_[3], philox_[4], philox_[5]}, block[4];
+    for(int b=0; b<16; b++)
+    {
+        _philox_block( counter, philox_, block );
+        counter[0]++;
+        out_[2*b] = ((uint64_t)block[0] << 32) | block[1];
+        out_[2*b+1] = ((uint64_t)block[2] << 32) | block[3];
+    }
+}
+
+#ifdef MEERKAT_RANDOM_GENERATOR_AVX2
+__attribute__((target("avx2")))
+void meerkat::mk_random_generator::_philox_batch_avx2( const uint32_t *philox_, uint64_t *out_ )
+{
+    // 2 x 8 blocks, one per 32-bit lane, two independent sets to hide the multiply latency;
+    // products of even and odd lanes are computed separately
+    const __m256i m0 = _mm256_set1_epi32( (int)0xD2511F53 );
+    const __m256i m1 = _mm256_set1_epi32( (int)0xCD9E8D57 );
+    const __m256i lo = _mm256_set1_epi64x( 0xffffffffLL );
+    __m256i c0[2], c1[2], c2[2], c3[2], k0, k1, pe0, po0, pe1, po1, hi0, lo0;
+    for(int v=0; v<2; v++)
+    {
+        c0[v] = _mm256_add_epi32( _mm256_set1_epi32( (int)philox_[2] ),
+                                  _mm256_setr_epi32( 8*v, 8*v+1, 8*v+2, 8*v+3,
+                                                     8*v+4, 8*v+5, 8*v+6, 8*v+7 ) );
+        c1[v] = _mm256_set1_epi32( (int)philox_[3] );
+        c2[v] = _mm256_set1_epi32( (int)philox_[4] );
+        c3[v] = _mm256_set1_epi32( (int)philox_[5] );
+    }
+    uint32_t key0 = philox_[0], key1 = philox_[1];
+    for(int r=0; r<10; r++)
+    {
+        k0 = _mm256_set1_epi32( (int)key0 );
+        k1 = _mm256_set1_epi32( (int)key1 );
+        for(int v=0; v<2; v++)
+        {
+            pe0 = _mm256_mul_epu32( c0[v], m0 );
+            po0 = _mm256_mul_epu32( _mm256_srli_epi64( c0[v], 32 ), m0 );
+            pe1 = _mm256_mul_epu32( c2[v], m1 );
+            po1 = _mm256_mul_epu32( _mm256_srli_epi64( c2[v], 32 ), m1 );
+            hi0 = _mm256_or_si256( _mm256_srli_epi64( pe0, 32 ), _mm256_andnot_si256( lo, po0 ) );
+            lo0 = _mm256_or_si256( _mm256_and_si256( pe0, lo ), _mm256_slli_epi64( po0, 32 ) );
+            c0[v] = _mm256_xor_si256( _mm256_xor_si256( _mm256_or_si256( _mm256_srli_epi64( pe1, 32 ),
+                                      _mm256_andnot_si256( lo, po1 ) ), c1[v] ), k0 );
+            c1[v] = _mm256_or_si256( _mm256_and_si256( pe1, lo ), _mm256_slli_epi64( po1, 32 ) );
+            c2[v] = _mm256_xor_si256( _mm256_xor_si256( hi0, c3[v] ), k1 );
+            c3[v] = lo0;
+        }
+        key0 += 0x9E3779B9;
+        key1 += 0xBB67AE85;
+    }
+    uint32_t w0[8], w1[8], w2[8], w3[8];
+    for(int v=0; v<2; v++)
+    {
+        _mm256_storeu_si256( (__m256i*)w0, c0[v] );
+        _mm256_storeu_si256( (__m256i*)w1, c1[v] );
+        _mm256_storeu_si256( (__m256i*)w2, c2[v] );
+        _mm256_storeu_si256( (__m256i*)w3, c3[v] );
+        for(int b=0; b<8; b++)
+        {
+            out_[16*v+2*b] = ((uint64_t)w0[b] << 32) | w1[b];
+            out_[16*v+2*b+1] = ((uint64_t)w2[b] << 32) | w3[b];
+        }
+    }
+}
+#endif
+
+void meerkat::mk_random_generator::_bulk_bits( uint64_t *data_, int n_ )
+{
+    if( _engine == Philox )
+        _philox_bits( data_, n_ );
+    else
+        _lane_bits( data_, (n_+3)/4 );
+}
+
+void meerkat::mk_random_generator::_seed_lanes()
+{
+    // Philox generates bulk numbers from its counter
+    if( _engine == Philox )
+    {
+        memset( _lanes, 0, sizeof(_lanes) );
+        return;
+    }
+
+    // seed as the xoshiro256** engine, then move away from its streams by long jumps
+    uint64_t sm = _seed;
+    uint64_t state[4];
+    for(int w=0; w<4; w++)
+        state[w] = _splitmix64( sm );
+    for(uint64_t j=0; j<=_stream; j++)
+        _xoshiro_jump( state, true );
+
+    // lanes are separated by jumps
+    for(int l=0; l<4; l++)
+    {
+        for(int w=0; w<4; w++)
+            _lanes[4*w + l] = state[w];
+        _xoshiro_jump( state, false );
+    }
+}
+
+void meerkat::mk_random_generator::_lane_bits( uint64_t *data_, int blocks_ )
+{
+#ifdef MEERKAT_RANDOM_GENERATOR_AVX2
+    static const bool hasAvx2 = __builtin_cpu_supports( "avx2" );
+    if( hasAvx2 )
+    {
+        _lane_bits_avx2( data_, blocks_ );
+        return;
+    }
+#endif
+    _lane_bits_scalar( data_, blocks_ );
+}
+
+void meerkat::mk_random_generator::_lane_bits_scalar( uint64_t *data_, int blocks_ )
+{
+    uint64_t *s0 = _lanes, *s1 = _lanes+4, *s2 = _lanes+8, *s3 = _lanes+12;
+    uint64_t x, t;
+    for(int b=0; b<blocks_; b++)
+    {
+        for(int l=0; l<4; l++)
+        {
+            x = s1[l] * 5;
+            x = (x << 7) | (x >> 57);
+            data_[4*b + l] = x * 9;
+            t = s1[l] << 17;
+            s2[l] ^= s0[l];
+            s3[l] ^= s1[l];
+            s1[l] ^= s2[l];
+            s0[l] ^= s3[l];
+            s2[l] ^= t;
+            s3[l] = (s3[l] << 45) | (s3[l] >> 19);
+        }
+    }
+}
+
+#ifdef MEERKAT_RANDOM_GENERATOR_AVX2
+__attribute__((target("avx2")))
+void meerkat::mk_random_generator::_lane_bits_avx2( uint64_t *data_, int blocks_ )
+{
+    __m256i s0 = _mm256_loadu_si256( (__m256i*)(_lanes) );
+    __m256i s1 = _mm256_loadu_si256( (__m256i*)(_lanes+4) );
+    __m256i s2 = _mm256_loadu_si256( (__m256i*)(_lanes+8) );
+    __m256i s3 = _mm256_loadu_si256( (__m256i*)(_lanes+12) );
+    __m256i x, t;
+    for(int b=0; b<blocks_; b++)
+    {
+        // rotl(s1 * 5, 7) * 9 with shifts and adds
+        x = _mm256_add_epi64( _mm256_slli_epi64(s1, 2), s1 );
+        x = _mm256_or_si256( _mm256_slli_epi64(x, 7), _mm256_srli_epi64(x, 57) );
+        x = _mm256_add_epi64( _mm256_slli_epi64(x, 3), x );
+        _mm256_storeu_si256( (__m256i*)(data_ + 4*b), x );
+
+        t = _mm256_slli_epi64( s1, 17 );
+        s2 = _mm256_xor_si256( s2, s0 );
+        s3 = _mm256_xor_si256( s3, s1 );
+        s1 = _mm256_xor_si256( s1, s2 );
+        s0 = _mm256_xor_si256( s0, s3 );
+        s2 = _mm256_xor_si256( s2, t );
+        s3 = _mm256_or_si256( _mm256_slli_epi64(s3, 45), _mm256_srli_epi64(s3, 19) );
+    }
+    _mm256_storeu_si256( (__m256i*)(_lanes), s0 );
+    _mm256_storeu_si256( (__m256i*)(_lanes+4), s1 );
+    _mm256_storeu_si256( (__m256i*)(_lanes+8), s2 );
+    _mm256_storeu_si256( (__m256i*)(_lanes+12), s3 );
+}
+#endif
+
+uint32_t meerkat::mk_random_generator::_bounded( uint32_t range_ )
+{
+    uint64_t m = (uint64_t)_random_bits() * range_;
+    uint32_t low = (uint32_t)m;
+    if( low < range_ )
+    {
+        // reject the 2^32 mod range lowest products
+        uint32_t threshold = (uint32_t)(-range_) % range_;
+        while( low < threshold )
+        {
+            m = (uint64_t)_random_bits() * range_;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+double meerkat::mk_random_generator::_random_double()
+{
+    // 64-bit engines: use 53 bits of mantissa
+    if( _engine != MotherOfAll )
+        return (double)(_random_bits64() >> 11) * (1.0/9007199254740992.0);
+    else
+        return (double)_random_bits() * (1./(65536.*65536.));
+}
+
 double meerkat::mk_random_generator::double_uniform( double min_, double max_ )
 {
-    double dsmall = (double)_random_bits() * (1./(65536.*65536.));
+    double dsmall = _random_double();
     return dsmall * (max_-min_) + min_;
 }
 
@@ -61,29 +731,70 @@ double meerkat::mk_random_generator::double_bounded_pareto( double min_, double
 
 double meerkat::mk_random_generator::double_normal( double mu_, double sigma_ )
 {
-    double U = double_uniform( 0.0, 1.0 );
-    double V = double_uniform( 0.0, 1.0 );
-    return mu_ + sigma_ * sqrt(-2.0*log(U)) * cos(6.28318*V) ;
+    const __ziggurat &z = ziggurat();
+    uint64_t u;
+    int i;
+    double x, a, b;
+    while( true )
+    {
+        // layer from the low 7 bits, sign from bit 7, position from the high 53 bits
+        u = _random_bits64();
+        i = (int)(u & 0x7f);
+        x = (double)(u >> 11) * z._normalW[i];
+        if( x < z._normalX[i+1] )
+            break;
+
+        if( i == 0 )
+        {
+            // tail beyond R (Marsaglia), uniforms in (0, 1] to avoid log(0)
+            do
+            {
+                a = -log( (double)((_random_bits64() >> 11) + 1) * (1.0/9007199254740992.0) ) / z._normalX[1];
+                b = -log( (double)((_random_bits64() >> 11) + 1) * (1.0/9007199254740992.0) );
+            } while( b+b < a*a );
+            x = z._normalX[1] + a;
+            break;
+        }
+
+        // wedge
+        if( z._normalF[i] + _random_double()*(z._normalF[i+1] - z._normalF[i]) < exp(-0.5*x*x) )
+            break;
+    }
+    return (u & 0x80) ? mu_ - sigma_*x : mu_ + sigma_*x;
 }
 
-void meerkat::mk_random_generator::double_shuffle( std::vector<double> &vec_ )
+double meerkat::mk_random_generator::double_exponential( double lambda_ )
 {
-    int length = (int)vec_.size();
-    int swaps = 10*length;
-    int v1, v2;
-    double elem;
-    while( swaps > 0 )
+    const __ziggurat &z = ziggurat();
+    uint64_t u;
+    int i;
+    double x, shift = 0.0;
+    while( true )
     {
-        v1 = integer_uniform( 0, length-1 );
-        v2 = integer_uniform( 0, length-1 );
-        if( v1 != v2 )
+        // layer from the low 8 bits, position from the high 53 bits
+        u = _random_bits64();
+        i = (int)(u & 0xff);
+        x = (double)(u >> 11) * z._expW[i];
+        if( x < z._expX[i+1] )
+            break;
+
+        // tail beyond R is a shifted exponential
+        if( i == 0 )
         {
-            elem = vec_[v1];
-            vec_[v1] = vec_[v2];
-            vec_[v2] = elem;
-            swaps--;
+            shift += z._expX[1];
+            continue;
         }
+
+        // wedge
+        if( z._expF[i] + _random_double()*(z._expF[i+1] - z._expF[i]) < exp(-x) )
+            break;
     }
+    return (shift + x) / lambda_;
+}
+
+void meerkat::mk_random_generator::double_shuffle( std::vector<double> &vec_ )
+{
+    shuffle( vec_.begin(), vec_.end() );
 }
 
 int meerkat::mk_random_generator::integer_uniform( int min_, int max_ )
@@ -100,6 +811,9 @@ int meerkat::mk_random_generator::integer_uniform( int min_, int max_ )
 
 int meerkat::mk_random_generator::integer_poisson( double lambda_ )
 {
+    if( lambda_ >= 10.0 )
+        return _poisson_ptrs( lambda_ );
+
     double L = exp(-lambda_);
     int k = 0;
     double p = 1.0;
@@ -113,6 +827,36 @@ int meerkat::mk_random_generator::integer_poisson( double lambda_ )
     return k-1;
 }
 
+int meerkat::mk_random_generator::integer_binomial( int n_, double p_ )
+{
+    if( n_ <= 0 || p_ <= 0.0 )
+        return 0;
+    if( p_ >= 1.0 )
+        return n_;
+
+    // draw the less likely outcome
+    double p = p_ <= 0.5 ? p_ : 1.0-p_;
+    int k = n_*p < 10.0 ? _binomial_inversion( n_, p ) : _binomial_btrs( n_, p );
+    return p_ <= 0.5 ? k : n_-k;
+}
+
+int meerkat::mk_random_generator::integer_geometric( double p_ )
+{
+    if( p_ >= 1.0 )
+        return 0;
+    if( !(p_ > 0.0) )
+    {
+        // never succeeds (also for NaN)
+        printf( "meerkat_random_generator warning: geometric probability is not positive.\n" );
+        return 2147483647;
+    }
+
+    // inversion with u in (0, 1]
+    double u = (double)((_random_bits64() >> 11) + 1) * (1.0/9007199254740992.0);
+    double k = floor( log(u) / log1p(-p_) );
+    return k < 2147483647.0 ? (int)k : 2147483647;
+}
+
 int meerkat::mk_random_generator::integer_bounded_pareto( int min_, int max_, double exponent_ )
 {
     return (int)double_bounded_pareto( (double)min_, (double)max_, exponent_ );
@@ -125,102 +869,260 @@ int meerkat::mk_random_generator::integer_normal( double mu_, double sigma_ )
 
 void meerkat::mk_random_generator::integer_shuffle( std::vector<int> &vec_ )
 {
-    int length = (int)vec_.size();
-    int swaps = 10*length;
-    int v1, v2;
-    int elem;
-    while( swaps > 0 )
+    shuffle( vec_.begin(), vec_.end() );
+}
+
+void meerkat::mk_random_generator::integer_sample( int n_, int k_, std::vector<int> &sample_ )
+{
+    sample_.clear();
+    if( k_ > n_ )
+        k_ = n_;
+    if( k_ <= 0 )
+        return;
+
+    // Floyd: for each of the last k candidates, draw from [0, j] and take j on collision
+    std::unordered_set<int> chosen;
+    chosen.reserve( (size_t)k_ );
+    sample_.reserve( (size_t)k_ );
+    int t;
+    for(int j=n_-k_; j<n_; j++)
     {
-        v1 = integer_uniform( 0, length-1 );
-        v2 = integer_uniform( 0, length-1 );
-        if( v1 != v2 )
+        t = (int)_bounded( (uint32_t)j+1 );
+        if( !chosen.insert(t).second )
         {
-            elem = vec_[v1];
-            vec_[v1] = vec_[v2];
-            vec_[v2] = elem;
-            swaps--;
+            chosen.insert( j );
+            t = j;
         }
+        sample_.push_back( t );
     }
 }
 
-void meerkat::mk_random_generator::setup_alias_table( std::vector<double> &weights_ )
+meerkat::mk_random_generator::mk_dynamic_table::mk_dynamic_table()
 {
-    _a._n = (int)weights_.size();
-    double sum = 0.0;
-    std::vector<double> p( _a._n, 0.0 );
-    std::vector<int> small_worklist;
-    std::vector<int> large_worklist;
+    _n = 0;
+    _leaves = 1;
+    _tree.assign( 2, 0.0 );
+}
+
+void meerkat::mk_random_generator::mk_dynamic_table::setup( const std::vector<double> &weights_ )
+{
+    _n = (int)weights_.size();
+    _leaves = 1;
+    while( _leaves < _n )
+        _leaves *= 2;
+
+    // leaves, then sums bottom up
+    _tree.assign( 2*_leaves, 0.0 );
+    for(int i=0; i<_n; i++)
+        _tree[_leaves+i] = weights_[i];
+    for(int i=_leaves-1; i>0; i--)
+        _tree[i] = _tree[2*i] + _tree[2*i+1];
+}
+
+void meerkat::mk_random_generator::mk_dynamic_table::update( int i_, double weight_ )
+{
+    // recompute sums on the path instead of adding the difference, so errors do not accumulate
+    int node = _leaves + i_;
+    _tree[node] = weight_;
+    for(node/=2; node>0; node/=2)
+        _tree[node] = _tree[2*node] + _tree[2*node+1];
+}
+
+double meerkat::mk_random_generator::mk_dynamic_table::weight( int i_ ) const
+{
+    return _tree[_leaves+i_];
+}
+
+double meerkat::mk_random_generator::mk_dynamic_table::total() const
+{
+    return _tree[1];
+}
+
+int meerkat::mk_random_generator::mk_dynamic_table::size() const
+{
+    return _n;
+}
 
-    // fill up worklists
-    for(int i=0; i<_a._n; i++)
+meerkat::mk_random_generator::mk_alias_table::mk_alias_table()
+{
+    _isTableSet = false;
+    _n = 0;
+}
+
+void meerkat::mk_random_generator::mk_alias_table::setup( const std::vector<double> &weights_ )
+{
+    _n = (int)weights_.size();
+    double sum = 0.0;
+    for(int i=0; i<_n; i++)
         sum += weights_[i];
-    for(int i=0; i<_a._n; i++)
+    _isTableSet = _n > 0 && sum > 0.0;
+    if( !_isTableSet )
+        return;
+
+    // fill up worklists: small ones from the front, large ones from the back
+    _p.resize( _n );
+    _work.resize( _n );
+    _cells.resize( _n );
+    int numSmall = 0, firstLarge = _n;
+    double scale = (double)_n / sum;
+    for(int i=0; i<_n; i++)
     {
-        p[i] = (double)_a._n * weights_[i] / sum;
-        if( p[i] <  1.0 )
-            small_worklist.push_back( i );
+        _p[i] = scale * weights_[i];
+        if( _p[i] < 1.0 )
+            _work[numSmall++] = i;
         else
-            large_worklist.push_back( i );
+            _work[--firstLarge] = i;
     }
 
     // fill up alias table
-    _a._prob.assign( _a._n, 0.0 );
-    _a._alias.assign( _a._n, 0 );
-    int small = 0, large = 0;
-    while( !small_worklist.empty() && !large_worklist.empty() )
-    {
-        small = small_worklist.back();
-        small_worklist.pop_back();
-        large = large_worklist.back();
-        large_worklist.pop_back();
-
-        _a._prob[small] = p[small];
-        _a._alias[small] = large;
-
-        p[large] += p[small] - 1.0;
-        if( p[large] < 1.0 )
-            small_worklist.push_back( large );
+    int small, large;
+    while( numSmall > 0 && firstLarge < _n )
+    {
+        small = _work[--numSmall];
+        large = _work[firstLarge++];
+
+        _cells[small]._threshold = (uint32_t)(_p[small] * 4294967296.0);
+        _cells[small]._alias = large;
+
+        _p[large] += _p[small] - 1.0;
+        if( _p[large] < 1.0 )
+            _work[numSmall++] = large;
         else
-            large_worklist.push_back( large );
+            _work[--firstLarge] = large;
     }
 
-    while( !large_worklist.empty() )
+    // remaining columns are full up to rounding
+    while( firstLarge < _n )
     {
-        large = large_worklist.back();
-        large_worklist.pop_back();
-        _a._prob[large] = 1.0;
-        _a._alias[large] = small;
+        large = _work[firstLarge++];
+        _cells[large]._threshold = 0xffffffff;
+        _cells[large]._alias = large;
     }
-
-    while( !small_worklist.empty() )
+    while( numSmall > 0 )
     {
-        small = small_worklist.back();
-        small_worklist.pop_back();
-        _a._prob[small] = 1.0;
-        _a._alias[small] = small;
+        small = _work[--numSmall];
+        _cells[small]._threshold = 0xffffffff;
+        _cells[small]._alias = small;
     }
+}
 
-    _a._isTableSet = true;
+void meerkat::mk_random_generator::mk_alias_table::clear()
+{
+    _n = 0;
+    _cells.clear();
+    _isTableSet = false;
+}
+
+void meerkat::mk_random_generator::setup_alias_table( std::vector<double> &weights_ )
+{
+    _a.setup( weights_ );
 }
 
 void meerkat::mk_random_generator::clear_alias_table()
 {
-    _a._n = 0;
-    _a._prob.clear();
-    _a._alias.clear();
-    _a._isTableSet = false;
+    _a.clear();
+}
+
+int meerkat::mk_random_generator::sample_dynamic_table( const mk_dynamic_table &table_ )
+{
+    if( !(table_.total() > 0.0) )
+    {
+        printf( "meerkat_random_generator error: dynamic table has no positive weight.\n" );
+        exit( 0 );
+    }
+
+    // descend from the root, never into an empty subtree due to rounding
+    double r = _random_double() * table_._tree[1];
+    int node = 1;
+    while( node < table_._leaves )
+    {
+        node *= 2;
+        if( r >= table_._tree[node] && table_._tree[node+1] > 0.0 )
+        {
+            r -= table_._tree[node];
+            node++;
+        }
+    }
+    return node - table_._leaves;
 }
 
 int meerkat::mk_random_generator::sample_alias_table()
 {
-    if( !_a._isTableSet )
+    return sample_alias_table( _a );
+}
+
+int meerkat::mk_random_generator::sample_alias_table( const mk_alias_table &table_ )
+{
+    if( !table_._isTableSet )
     {
         printf( "meerkat_random_generator error: alias table is unitialized.\n" );
         exit( 0 );
     }
-    int ret = integer_uniform( 0, _a._n-1 );
-    if( double_uniform(0.0, 1.0) < _a._prob[ret] )
-        return ret;
-    else
-        return _a._alias[ret];
+
+    // column from the high 32 bits, coin from the low 32 bits
+    uint64_t bits = _random_bits64();
+    int column = (int)(((bits >> 32) * (uint64_t)table_._n) >> 32);
+    const mk_alias_table::mk_alias_cell &cell = table_._cells[column];
+    return (uint32_t)bits < cell._threshold ? column : cell._alias;
+}
+
+
+void meerkat::mk_random_generator::fill_uniform( double *data_, int n_, double min_, double max_ )
+{
+    uint64_t bits[256];
+    double scale = max_ - min_, u;
+    uint64_t one = 0x3ff0000000000000ULL, b;
+    int chunk;
+    for(int i=0; i<n_; i+=chunk)
+    {
+        chunk = n_-i < 256 ? n_-i : 256;
+        _bulk_bits( bits, chunk );
+
+        // set 52 mantissa bits of a double in [1, 2)
+        for(int j=0; j<chunk; j++)
+        {
+            b = (bits[j] >> 12) | one;
+            memcpy( &u, &b, sizeof(double) );
+            data_[i+j] = (u - 1.0) * scale + min_;
+        }
+    }
+}
+
+void meerkat::mk_random_generator::fill_integer_uniform( int *data_, int n_, int min_, int max_ )
+{
+    uint64_t bits[256];
+    uint64_t interval = (uint64_t)(uint32_t)(max_ - min_ + 1);
+    int chunk;
+    for(int i=0; i<n_; i+=chunk)
+    {
+        chunk = n_-i < 256 ? n_-i : 256;
+        _bulk_bits( bits, chunk );
+
+        // scale high 32 bits to the interval
+        for(int j=0; j<chunk; j++)
+            data_[i+j] = (int32_t)(((bits[j] >> 32) * interval) >> 32) + min_;
+    }
+}
+
+void meerkat::mk_random_generator::fill_normal( double *data_, int n_, double mu_, double sigma_ )
+{
+    uint64_t bits[256];
+    double u, v, r;
+    int chunk;
+    for(int i=0; i<n_; i+=chunk)
+    {
+        chunk = n_-i < 256 ? n_-i : 256;
+        _bulk_bits( bits, chunk + chunk%2 );
+
+        // Box-Muller with both variates, u in (0, 1] to avoid log(0)
+        for(int j=0; j<chunk; j+=2)
+        {
+            u = (double)((bits[j] >> 11) + 1) * (1.0/9007199254740992.0);
+            v = (double)(bits[j+1] >> 11) * (1.0/9007199254740992.0);
+            r = sigma_ * sqrt( -2.0*log(u) );
+            data_[i+j] = mu_ + r * cos( 2.0*M_PI*v );
+            if( j+1 < chunk )
+                data_[i+j+1] = mu_ + r * sin( 2.0*M_PI*v );
+        }
+    }
 }
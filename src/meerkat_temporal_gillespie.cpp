@@ -0,0 +1,275 @@
+#include "meerkat_temporal_gillespie.hpp"
+
+
+double meerkat::mk_temporal_gillespie::_node_rate( int nodeId_ ) const
+{
+    const std::vector<int> &ids = _byState[_states[nodeId_]];
+    const int *counts = &_counts[nodeId_*_numStates];
+    double rate = 0.0;
+    for( int t=0; t<(int)ids.size(); t++ )
+    {
+        const __transition &tr = _transitions[ids[t]];
+        rate += tr._source < 0 ? tr._rate : tr._rate * counts[tr._source];
+    }
+    return rate;
+}
+
+void meerkat::mk_temporal_gillespie::_rebuild()
+{
+    int o = _network->order();
+
+    // Count states of active in-neighbors
+    _counts.assign( o*_numStates, 0 );
+    for( int i=0; i<o; i++ )
+    {
+        const std::vector<mk_temporal_network::__edge*> &active = _network->_active_in_neighbors( i );
+        for( int j=0; j<(int)active.size(); j++ )
+            _counts[i*_numStates + _states[active[j]->_ptr->_id]]++;
+    }
+
+    // Set up rates
+    std::vector<double> rates( o );
+    for( int i=0; i<o; i++ )
+        rates[i] = _node_rate( i );
+    _rates.setup( rates );
+}
+
+void meerkat::mk_temporal_gillespie::_change_state( int nodeId_, int state_ )
+{
+    int old = _states[nodeId_];
+    _states[nodeId_] = state_;
+    _population[old]--;
+    _population[state_]++;
+    if( !_isReady )
+        return;
+
+    // Node itself and nodes it is an active in-neighbor of
+    _rates.update( nodeId_, _node_rate(nodeId_) );
+    const std::vector<mk_temporal_network::__edge*> &active = _network->_nodes[nodeId_]->_activeNeighbors;
+    int k;
+    for( int j=0; j<(int)active.size(); j++ )
+    {
+        k = active[j]->_ptr->_id;
+        _counts[k*_numStates + old]--;
+        _counts[k*_numStates + state_]++;
+        _rates.update( k, _node_rate(k) );
+    }
+}
+
+void meerkat::mk_temporal_gillespie::_apply_switches()
+{
+    const std::vector<std::pair<int, mk_temporal_network::__edge*> > &switches = _network->_switches;
+    int i;
+    mk_temporal_network::__edge *edge;
+    for( int s=0; s<(int)switches.size(); s++ )
+    {
+        i = switches[s].first;
+        edge = switches[s].second;
+        _counts[i*_numStates + _states[edge->_ptr->_id]] += edge->_activeTime > 0 ? 1 : -1;
+        _rates.update( i, _node_rate(i) );
+    }
+}
+
+void meerkat::mk_temporal_gillespie::_fire( int nodeId_ )
+{
+    // Choose transition by rate
+    const std::vector<int> &ids = _byState[_states[nodeId_]];
+    const int *counts = &_counts[nodeId_*_numStates];
+    double r = _generator->double_uniform( 0.0, _rates.weight(nodeId_) ), rate;
+    int last = (int)ids.size() - 1;
+    for( int t=0; t<last; t++ )
+    {
+        const __transition &tr = _transitions[ids[t]];
+        rate = tr._source < 0 ? tr._rate : tr._rate * counts[tr._source];
+        if( r < rate )
+        {
+            last = t;
+            break;
+        }
+        r -= rate;
+    }
+    _change_state( nodeId_, _transitions[ids[last]]._to );
+}
+
+meerkat::mk_temporal_gillespie::mk_temporal_gillespie( mk_temporal_network *network_,
+                                                       mk_random_generator *generator_ )
+{
+    _network = network_;
+    _generator = generator_;
+    _numStates = 0;
+    _isReady = false;
+    _tau = 0.0;
+    _start = 0;
+    _steps = 0;
+    _eventTime = 0.0;
+    _events = 0;
+    _log.tag( "mk_temporal_gillespie" );
+}
+
+meerkat::mk_temporal_gillespie::~mk_temporal_gillespie()
+{
+    _network->_trackSwitches = false;
+}
+
+bool meerkat::mk_temporal_gillespie::set_states( int numStates_ )
+{
+    if( numStates_ <= 0 )
+    {
+        _log.e( "set_states", "number of states must be positive" );
+        return false;
+    }
+    if( _network->order() == 0 )
+    {
+        _log.e( "set_states", "network is not created" );
+        return false;
+    }
+
+    _numStates = numStates_;
+    _transitions.clear();
+    _byState.assign( _numStates, std::vector<int>() );
+    _states.assign( _network->order(), 0 );
+    _population.assign( _numStates, 0 );
+    _population[0] = _network->order();
+    _isReady = false;
+    return true;
+}
+
+bool meerkat::mk_temporal_gillespie::add_transition( int from_, int to_, double rate_ )
+{
+    return add_contact_transition( from_, to_, -1, rate_ );
+}
+
+bool meerkat::mk_temporal_gillespie::add_contact_transition( int from_, int to_, int source_,
+                                                             double rate_ )
+{
+    if( from_ < 0 || from_ >= _numStates || to_ < 0 || to_ >= _numStates
+            || source_ < -1 || source_ >= _numStates )
+    {
+        _log.e( "add_transition", "invalid state(s)" );
+        return false;
+    }
+    if( rate_ < 0.0 )
+    {
+        _log.e( "add_transition", "negative rate" );
+        return false;
+    }
+
+    __transition tr;
+    tr._from = from_;
+    tr._to = to_;
+    tr._source = source_;
+    tr._rate = rate_;
+    _byState[from_].push_back( (int)_transitions.size() );
+    _transitions.push_back( tr );
+    _isReady = false;
+    return true;
+}
+
+bool meerkat::mk_temporal_gillespie::set_state( int nodeId_, int state_ )
+{
+    if( !_network->_is_node_id_valid(nodeId_) || nodeId_ >= (int)_states.size() )
+    {
+        _log.w( "set_state", "invalid node id" );
+        return false;
+    }
+    if( state_ < 0 || state_ >= _numStates )
+    {
+        _log.w( "set_state", "invalid state" );
+        return false;
+    }
+
+    if( _states[nodeId_] != state_ )
+        _change_state( nodeId_, state_ );
+    return true;
+}
+
+bool meerkat::mk_temporal_gillespie::init( int time_ )
+{
+    if( _numStates == 0 || (int)_states.size() != _network->order() )
+    {
+        _log.e( "init", "states are not set" );
+        return false;
+    }
+    if( time_ < 0 || time_ >= _network->maxTime() )
+    {
+        _log.e( "init", "invalid time index" );
+        return false;
+    }
+
+    _network->_trackSwitches = true;
+    _network->set_clock( time_ );
+    _rebuild();
+    _isReady = true;
+    _tau = _generator->double_exponential( 1.0 );
+    _start = time_;
+    _steps = 0;
+    _eventTime = (double)time_;
+    _events = 0;
+    return true;
+}
+
+int meerkat::mk_temporal_gillespie::run( int steps_ )
+{
+    if( !_isReady )
+    {
+        _log.e( "run", "simulation is not initialized" );
+        return 0;
+    }
+
+    int fired = 0;
+    double left, total;
+    for( int s=0; s<steps_; s++ )
+    {
+        // Events while the integrated rate of the rest of the step exceeds tau
+        left = 1.0;
+        while( (total = _rates.total()) * left > _tau )
+        {
+            left -= _tau / total;
+            _eventTime = _start + _steps + (1.0 - left);
+            _fire( _generator->sample_dynamic_table(_rates) );
+            _tau = _generator->double_exponential( 1.0 );
+            fired++;
+        }
+        _tau -= total * left;
+
+        // Next step: contacts switch, or everything is recounted when the clock restarts
+        _network->update_clock();
+        _steps++;
+        if( _network->time() == 0 )
+            _rebuild();
+        else
+            _apply_switches();
+    }
+    _events += fired;
+    return fired;
+}
+
+int meerkat::mk_temporal_gillespie::state( int nodeId_ ) const
+{
+    return _states[nodeId_];
+}
+
+int meerkat::mk_temporal_gillespie::population( int state_ ) const
+{
+    return _population[state_];
+}
+
+double meerkat::mk_temporal_gillespie::total_rate() const
+{
+    return _rates.total();
+}
+
+double meerkat::mk_temporal_gillespie::time() const
+{
+    return (double)(_start + _steps);
+}
+
+double meerkat::mk_temporal_gillespie::last_event_time() const
+{
+    return _eventTime;
+}
+
+unsigned long meerkat::mk_temporal_gillespie::events() const
+{
+    return _events;
+}
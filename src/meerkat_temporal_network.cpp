@@ -1,51 +1,237 @@
 #include "meerkat_temporal_network.hpp"
 
 
-meerkat::mk_temporal_network::__edge::__edge( __node *ptr_, std::vector<bool> &activity_ )
+meerkat::mk_temporal_network::__activity::__activity( const int length_, const bool compact_ )
 {
-    // Set pointer
-    _ptr = ptr_;
+    _compact = compact_;
+    _length = length_;
+    _size = 0;
+    _total = 0;
+    _end = 0;
+    _offset = 0;
+}
 
-    // Set time vectors
-    int length = (int)activity_.size();
-    int s, d = 0;
-    for( int i=0; i<length; i++ )
+void meerkat::mk_temporal_network::__activity::push( const int start_, const int duration_ )
+{
+    if( _compact )
     {
-        // Active time index found
-        if( activity_[i] )
+        // Start new block, its skip pointer is written inline until shrink() (the first block
+        // needs none)
+        if( _size > 0 && _size % _blockSize == 0 )
         {
-            // Take start time and start counting duration
-            s = i;
-            d = 1;
+            __block block;
+            block._offset = 0;
+            block._base = _end;
+            block._first = start_;
+            const unsigned char *pos = (const unsigned char*)&block;
+            _data.insert( _data.end(), pos, pos + sizeof(__block) );
+        }
 
-            // Go through activity elements
-            while( true )
+        // Encode gap and duration as varints
+        unsigned int values[2] = {(unsigned int)(start_ - _end), (unsigned int)duration_};
+        for( int v=0; v<2; v++ )
+        {
+            while( values[v] >= 0x80 )
             {
-                i++;
-                // If edge is active, increment duration
-                if( activity_[i] )
-                    d++;
-                // Otherwise, take start time and duration
-                else
-                {
-                    _starts.push_back(s);
-                    _durations.push_back(d);
-                    break;
-                }
+                _data.push_back( (unsigned char)(values[v] | 0x80) );
+                values[v] >>= 7;
             }
+            _data.push_back( (unsigned char)values[v] );
+        }
+    }
+    else
+    {
+        int interval[2] = {start_, duration_};
+        const unsigned char *pos = (const unsigned char*)interval;
+        _data.insert( _data.end(), pos, pos + sizeof(interval) );
+    }
+
+    _end = start_ + duration_;
+    _total += duration_;
+    _size++;
+}
+
+void meerkat::mk_temporal_network::__activity::shrink()
+{
+    if( !_compact || _size == 0 )
+    {
+        std::vector<unsigned char>( _data ).swap( _data );
+        return;
+    }
+
+    // Collect the inline skip pointers in front of the encoded intervals
+    int numSkips = (_size - 1) / _blockSize;
+    std::vector<unsigned char> data( _data.size() );
+    int pos = 0, out = numSkips * (int)sizeof(__block), begin, count;
+    __block block;
+    for( int b=0; b<=numSkips; b++ )
+    {
+        if( b > 0 )
+        {
+            memcpy( &block, &_data[pos], sizeof(__block) );
+            block._offset = out;
+            memcpy( &data[(b-1)*sizeof(__block)], &block, sizeof(__block) );
+            pos += (int)sizeof(__block);
         }
+        begin = pos;
+        count = _size - b*_blockSize < _blockSize ? _size - b*_blockSize : _blockSize;
+        for( int v=0; v<2*count; v++ )
+            while( _data[pos++] & 0x80 );
+        memcpy( &data[out], &_data[begin], pos - begin );
+        out += pos - begin;
     }
+    _data.swap( data );
+}
 
-    // Set final time step with duration of -1.
-    // The invalid duration marks the end of the clock, at which it is set back to start.
-    _starts.push_back( length );
-    _durations.push_back( -1 );
+void meerkat::mk_temporal_network::__activity::rewind( __cursor &cursor_ ) const
+{
+    cursor_._index = -1;
+    cursor_._offset = _compact && _size > 0 ? (_size - 1) / _blockSize * (int)sizeof(__block) : 0;
+    cursor_._base = 0;
+    next( cursor_ );
 }
 
-meerkat::mk_temporal_network::__node::__node( const int id_, const std::string label_ )
+void meerkat::mk_temporal_network::__activity::next( __cursor &cursor_ ) const
+{
+    if( cursor_._index < _size )
+        cursor_._index++;
+
+    // End of time is marked with an invalid duration, at which the clock is set back to start
+    if( cursor_._index == _size )
+    {
+        cursor_._start = _length;
+        cursor_._duration = -1;
+        return;
+    }
+
+    if( _compact )
+    {
+        // Decode gap and duration
+        unsigned int values[2] = {0, 0};
+        int shift;
+        unsigned char byte;
+        for( int v=0; v<2; v++ )
+        {
+            shift = 0;
+            do
+            {
+                byte = _data[cursor_._offset++];
+                values[v] |= (unsigned int)(byte & 0x7f) << shift;
+                shift += 7;
+            } while( byte & 0x80 );
+        }
+        cursor_._start = cursor_._base + (int)values[0];
+        cursor_._duration = (int)values[1];
+        cursor_._base = cursor_._start + cursor_._duration;
+    }
+    else
+        interval( cursor_._index, cursor_._start, cursor_._duration );
+}
+
+int meerkat::mk_temporal_network::__activity::seek( __cursor &cursor_, const int time_ ) const
+{
+    int prevStart = 0, prevDuration = 0;
+    if( _compact )
+    {
+        // Find last block starting not later than time, skip pointer k is of block k+1
+        int lo = 0, hi = _size > 0 ? (_size - 1) / _blockSize : 0, mid;
+        while( lo < hi )
+        {
+            mid = (lo + hi) / 2;
+            if( skip(mid)._first <= time_ )
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        // Decode block until first interval starting after time
+        if( lo == 0 )
+            rewind( cursor_ );
+        else
+        {
+            __block block = skip( lo-1 );
+            cursor_._index = lo * _blockSize - 1;
+            cursor_._offset = block._offset;
+            cursor_._base = block._base;
+            next( cursor_ );
+        }
+        while( cursor_._duration >= 0 && cursor_._start <= time_ )
+        {
+            prevStart = cursor_._start;
+            prevDuration = cursor_._duration;
+            next( cursor_ );
+        }
+    }
+    else
+    {
+        // Binary search in starting times
+        int lo = 0, hi = _size, mid, start, duration;
+        while( lo < hi )
+        {
+            mid = (lo + hi) / 2;
+            interval( mid, start, duration );
+            if( start <= time_ )
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        cursor_._index = lo - 1;
+        if( cursor_._index >= 0 )
+            interval( cursor_._index, prevStart, prevDuration );
+        next( cursor_ );
+    }
+
+    // Remaining active time
+    int activeTime = prevDuration - (time_ - prevStart);
+    return activeTime > 0 ? activeTime : 0;
+}
+
+meerkat::mk_temporal_network::__activity::__block
+meerkat::mk_temporal_network::__activity::skip( const int index_ ) const
+{
+    __block block;
+    memcpy( &block, &_data[index_ * sizeof(__block)], sizeof(__block) );
+    return block;
+}
+
+void meerkat::mk_temporal_network::__activity::interval( const int index_, int &start_,
+                                                          int &duration_ ) const
+{
+    int values[2];
+    memcpy( values, &_data[index_ * sizeof(values)], sizeof(values) );
+    start_ = values[0];
+    duration_ = values[1];
+}
+
+unsigned long meerkat::mk_temporal_network::__activity::bytes() const
+{
+    return sizeof(__activity) + _data.capacity() * sizeof(unsigned char);
+}
+
+meerkat::mk_temporal_network::__edge::__edge( __node *ptr_, __activity *activity_ )
+{
+    _ptr = ptr_;
+    _activity = activity_;
+    _timeIndex = 0;
+    _activeTime = 0;
+    _waitingTime = 0;
+    _activity->rewind( _cursor );
+}
+
+bool meerkat::mk_temporal_network::__contact::operator<( const __contact &c_ ) const
+{
+    if( _node1 != c_._node1 )
+        return _node1 < c_._node1;
+    if( _node2 != c_._node2 )
+        return _node2 < c_._node2;
+    if( _start != c_._start )
+        return _start < c_._start;
+    return _end < c_._end;
+}
+
+meerkat::mk_temporal_network::__node::__node( const int id_ )
 {
     _id = id_;
-    _label = label_;
 }
 
 bool meerkat::mk_temporal_network::__node::add_neighbor( __edge *edge_ )
@@ -60,62 +246,56 @@ bool meerkat::mk_temporal_network::__node::add_neighbor( __edge *edge_ )
     }
 }
 
-bool meerkat::mk_temporal_network::__node::set_clock( const int time_ )
+bool meerkat::mk_temporal_network::__node::add_in_neighbor( __edge *edge_ )
 {
-    // Check if time is valid (inside total time interval)
-    if( (int)_neighbors.size() > 0 )
+    // Check if edge or in-neighbor is null
+    if( edge_ == NULL || edge_->_ptr == NULL )
+        return false;
+    else
     {
-        if( time_ >= _neighbors[0]->_starts.back() )
-            return false;
+        _inNeighbors.push_back( edge_ );
+        return true;
     }
+}
 
-    int deg = (int)_neighbors.size();
+void meerkat::mk_temporal_network::__node::set_clock( std::vector<__edge*> &edges_,
+                                                      std::vector<__edge*> &activeNeighbors_,
+                                                      const int time_ )
+{
+    int deg = (int)edges_.size();
     __edge *edge = NULL;
     for( int i=0; i<deg; i++ )
     {
-        edge = _neighbors[i];
+        edge = edges_[i];
 
         // Time index
         edge->_timeIndex = time_;
 
-        // Vector index
-        edge->_vectorIndex = 0;
-        while( edge->_starts[edge->_vectorIndex] <= edge->_timeIndex )
-        {
-            edge->_vectorIndex++;
-        }
-
-        // Active time
-        if( edge->_vectorIndex == 0 )
-            edge->_activeTime = 0;
-        else
-        {
-            edge->_activeTime = edge->_durations[edge->_vectorIndex-1]
-                    - (edge->_timeIndex - edge->_starts[edge->_vectorIndex-1]);
-            if( edge->_activeTime < 0 )
-                edge->_activeTime = 0;
-        }
-        edge->_waitingTime = edge->_starts[edge->_vectorIndex] - edge->_timeIndex;
+        // Interval position and active time
+        edge->_activeTime = edge->_activity->seek( edge->_cursor, time_ );
+        edge->_waitingTime = edge->_cursor._start - edge->_timeIndex;
     }
 
     // Also update active neighbors
-    _activeNeighbors.clear();
+    activeNeighbors_.clear();
     for( int j=0; j<deg; j++ )
     {
-        if( _neighbors[j]->_activeTime > 0 )
-            _activeNeighbors.push_back( _neighbors[j]->_ptr );
+        if( edges_[j]->_activeTime > 0 )
+            activeNeighbors_.push_back( edges_[j] );
     }
-
-    return true;
 }
 
-void meerkat::mk_temporal_network::__node::update_clock()
+void meerkat::mk_temporal_network::__node::update_clock( std::vector<__edge*> &edges_,
+                                                         std::vector<__edge*> &activeNeighbors_,
+                                                         std::vector<__edge*> *switched_ )
 {
-    int deg = (int)_neighbors.size();
+    int deg = (int)edges_.size();
     __edge *edge;
+    bool wasActive;
     for( int i=0; i<deg; i++ )
     {
-        edge = _neighbors[i];
+        edge = edges_[i];
+        wasActive = edge->_activeTime > 0;
 
         // Increment time
         edge->_timeIndex++;
@@ -128,26 +308,55 @@ void meerkat::mk_temporal_network::__node::update_clock()
         edge->_waitingTime--;
         if( edge->_waitingTime == 0 )
         {
-            edge->_activeTime = edge->_durations[edge->_vectorIndex];
-            edge->_vectorIndex++;
-            edge->_waitingTime = edge->_starts[edge->_vectorIndex] - edge->_timeIndex;
+            edge->_activeTime = edge->_cursor._duration;
+            edge->_activity->next( edge->_cursor );
+            edge->_waitingTime = edge->_cursor._start - edge->_timeIndex;
         }
+
+        // Record switch
+        if( switched_ != NULL && wasActive != (edge->_activeTime > 0) )
+            switched_->push_back( edge );
     }
 
     // Update active neighbors
-    _activeNeighbors.clear();
+    activeNeighbors_.clear();
     for( int j=0; j<deg; j++ )
     {
-        if( _neighbors[j]->_activeTime > 0 )
-            _activeNeighbors.push_back(_neighbors[j]->_ptr);
+        if( edges_[j]->_activeTime > 0 )
+            activeNeighbors_.push_back( edges_[j] );
+    }
+}
+
+bool meerkat::mk_temporal_network::__node::set_clock( const int time_ )
+{
+    // Check if time is valid (inside total time interval)
+    if( (int)_neighbors.size() > 0 )
+    {
+        if( time_ >= _neighbors[0]->_activity->_length )
+            return false;
+    }
+    if( (int)_inNeighbors.size() > 0 )
+    {
+        if( time_ >= _inNeighbors[0]->_activity->_length )
+            return false;
     }
+
+    set_clock( _neighbors, _activeNeighbors, time_ );
+    set_clock( _inNeighbors, _activeInNeighbors, time_ );
+    return true;
+}
+
+void meerkat::mk_temporal_network::__node::update_clock()
+{
+    update_clock( _neighbors, _activeNeighbors );
+    update_clock( _inNeighbors, _activeInNeighbors );
 }
 
 
 int meerkat::mk_temporal_network::node_id( std::string label_ ) const
 {
-    if( _labelsHash.find(label_) != _labelsHash.end() )
-        return _labelsHash.at(label_);
+    if( _labels->_hash.find(label_) != _labels->_hash.end() )
+        return _labels->_hash.at(label_);
     else
         return -1;
 }
@@ -168,6 +377,43 @@ bool meerkat::mk_temporal_network::_is_there_edge( const int node1Id_, const int
     return false;
 }
 
+const std::vector<meerkat::mk_temporal_network::__edge*>
+&meerkat::mk_temporal_network::_in_edges( const int nodeId_ ) const
+{
+    return _directed ? _nodes[nodeId_]->_inNeighbors : _nodes[nodeId_]->_neighbors;
+}
+
+const std::vector<meerkat::mk_temporal_network::__edge*>
+&meerkat::mk_temporal_network::_active_in_neighbors( const int nodeId_ ) const
+{
+    return _directed ? _nodes[nodeId_]->_activeInNeighbors : _nodes[nodeId_]->_activeNeighbors;
+}
+
+void meerkat::mk_temporal_network::_share_labels( __labels *labels_ )
+{
+    if( !_sharedLabels )
+        delete _labels;
+    _labels = labels_;
+    _sharedLabels = true;
+}
+
+void meerkat::mk_temporal_network::_sync_nodes()
+{
+    int numLabels = (int)_labels->_labels.size();
+    while( (int)_nodes.size() < numLabels )
+        _nodes.push_back( new __node((int)_nodes.size()) );
+}
+
+void meerkat::mk_temporal_network::_set_frame( unsigned long startTimestamp_,
+                                               unsigned long endTimestamp_,
+                                               unsigned long timeWindow_ )
+{
+    _isFrameSet = true;
+    _frameStart = startTimestamp_;
+    _frameEnd = endTimestamp_;
+    _frameWindow = timeWindow_;
+}
+
 bool meerkat::mk_temporal_network::_add_node( const std::string label_ )
 {
     // Check label
@@ -179,101 +425,225 @@ bool meerkat::mk_temporal_network::_add_node( const std::string label_ )
     else
     {
         std::pair<std::map<std::string, int>::iterator, bool> added;
-        added = _labelsHash.insert(
-                    std::pair<std::string, int>( std::string(label_), (int)_labelsHash.size() )
+        added = _labels->_hash.insert(
+                    std::pair<std::string, int>( label_, (int)_labels->_labels.size() )
                     );
         if( added.second )
-        {
-            _nodes.push_back( new __node( (int)_labelsHash.size()-1, label_ ) );
-            return true;
-        }
-        else
-            return false;
+            _labels->_labels.push_back( label_ );
+
+        // Label might already be in a shared table, add node anyway
+        _sync_nodes();
+        return added.second;
     }
 }
 
 bool meerkat::mk_temporal_network::_add_edge( const int node1Id_, const int node2Id_,
-                                              std::vector<bool> &activity_ )
+                                              __activity *activity_ )
 {
     // Check node ids
     if( !_is_node_id_valid(node1Id_) || !_is_node_id_valid(node2Id_) )
     {
         _log.w( "_add_edge", "invalid node id(s)" );
+        delete activity_;
         return false;
     }
     else
     {
-        // No multiple and no self-edges are allowed
-        if( node1Id_ != node2Id_ && !_is_there_edge(node1Id_, node2Id_) )
+        // No self-edges are allowed
+        if( node1Id_ != node2Id_ )
         {
-            // Add neighbors
+            // Add neighbors sharing the same activity
+            activity_->_offset = _numIntervals;
+            _numIntervals += activity_->_size;
+            _activities.push_back( activity_ );
             __edge *neighbor = new __edge( _nodes[node2Id_], activity_ );
             _nodes[node1Id_]->add_neighbor( neighbor );
             neighbor = new __edge( _nodes[node1Id_], activity_ );
-            _nodes[node2Id_]->add_neighbor( neighbor );
+            if( _directed )
+                _nodes[node2Id_]->add_in_neighbor( neighbor );
+            else
+                _nodes[node2Id_]->add_neighbor( neighbor );
             return true;
         }
         else
+        {
+            delete activity_;
             return false;
+        }
     }
 }
 
-meerkat::mk_temporal_network::mk_temporal_network()
+void meerkat::mk_temporal_network::_set_attribute_names( const std::string &header_,
+                                                         char separator_ )
 {
-    _currentTime = 0;
-    _maxTime = 0;
-    _log.tag( "mk_temporal_network" );
+    _attributeNames.clear();
+    mk_file_manager::mk_line column;
+    const char *pos = header_.c_str(), *end = pos + header_.size();
+    int c = 0;
+    while( mk_file_manager::parse_token(pos, end, column, separator_) )
+    {
+        // First four columns are the nodes, time and duration
+        if( c >= 4 )
+            _attributeNames.push_back( column.str() );
+        c++;
+    }
 }
 
-meerkat::mk_temporal_network::~mk_temporal_network()
+void meerkat::mk_temporal_network::_sort_contacts( std::vector<__contact> &contacts_ )
 {
-    destroy();
-}
+    // Sort small inputs directly
+    int numContacts = (int)contacts_.size();
+    int numThreads = (int)std::thread::hardware_concurrency();
+    if( numThreads < 2 || numContacts < 65536 )
+    {
+        std::sort( contacts_.begin(), contacts_.end() );
+        return;
+    }
 
-bool meerkat::mk_temporal_network::create( const std::string filename_,
-                                           bool reverseTime_ )
-{
-    /// Try to open file.
-    mk_file_manager fm;
-    if( !fm.read(filename_) )
+    // Sort chunks in parallel
+    std::vector<int> bounds( numThreads+1, 0 );
+    for( int t=0; t<=numThreads; t++ )
+        bounds[t] = int( (long long)numContacts * t / numThreads );
+    std::vector<std::thread> threads;
+    for( int t=0; t<numThreads; t++ )
     {
-        _log.e( "create", "no such file: '%s'", filename_.c_str() );
-        return false;
+        threads.push_back( std::thread(std::sort<std::vector<__contact>::iterator>,
+                                       contacts_.begin() + bounds[t],
+                                       contacts_.begin() + bounds[t+1]) );
     }
+    for( int t=0; t<numThreads; t++ )
+        threads[t].join();
 
-    /// Read number of rows.
-    int rows = fm.rows();
+    // Merge sorted chunks pairwise
+    for( int width=1; width<numThreads; width*=2 )
+    {
+        threads.clear();
+        for( int t=0; t+width<numThreads; t+=2*width )
+        {
+            int hi = t+2*width < numThreads ? t+2*width : numThreads;
+            threads.push_back( std::thread(std::inplace_merge<std::vector<__contact>::iterator>,
+                                           contacts_.begin() + bounds[t],
+                                           contacts_.begin() + bounds[t+width],
+                                           contacts_.begin() + bounds[hi]) );
+        }
+        for( int t=0; t<(int)threads.size(); t++ )
+            threads[t].join();
+    }
+}
 
-    /// Determine min and max times (also take lines)
-    char line[1024] = {""};
-    std::vector<std::string> lines( rows, "" );
-    char node1Label[128] = {""}, node2Label[128] = {""};
-    unsigned long edgeTime = 0, edgeDuration = 0;
+bool meerkat::mk_temporal_network::_read_contacts( mk_file_manager &fm_, bool addNodes_ )
+{
+    /// Read attribute names from header, columns are separated by commas if the header has any
+    mk_file_manager::mk_line span;
+    int rows = fm_.mapped() ? fm_.rows() - 1 : 0;
+    char separator = ' ';
+    if( fm_.next_line(span) )
+    {
+        if( memchr(span._data, ',', span._size) != NULL )
+            separator = ',';
+        _set_attribute_names( span.str(), separator );
+    }
+    int numAttributes = attributes();
 
-    // Eat up header
-    fm.get_line();
+    /// Read contacts in parallel chunks and determine min and max times
+    std::vector<int> types( 4 + numAttributes, mk_file_manager::Real );
+    types[0] = types[1] = mk_file_manager::Label;
+    types[2] = types[3] = mk_file_manager::Unsigned;
+    if( !fm_.start_chunks(types, 4, separator) )
+        return false;
+    std::vector<__contact> &contacts = _pending._contacts;
+    std::vector<double> &values = _pending._values;
+    contacts.clear();
+    contacts.reserve( rows > 0 ? rows : 0 );
+    values.clear();
+    mk_file_manager::mk_chunk chunk;
+    std::vector<int> ids;
+    std::string label;
+    int numInvalid = 0;
+    __contact c;
+    unsigned long startTimestamp = ULONG_MAX, endTimestamp = 0, timeWindow = ULONG_MAX;
+    while( fm_.next_chunk(chunk) )
+    {
+        // Node ids of the labels in the chunk, added in the order of first appearance
+        numInvalid += (int)chunk._invalid;
+        ids.resize( chunk._labels.size() );
+        for( int l=0; l<(int)chunk._labels.size(); l++ )
+        {
+            label.assign( chunk._labels[l]._data, chunk._labels[l]._size );
+            if( addNodes_ )
+                _add_node( label );
+            ids[l] = node_id( label );
+        }
 
-    // Set start and end timestamp initial values
-    strcpy(line, fm.get_line().c_str());
-    sscanf( line, "%s %s %lu %lu", node1Label, node2Label, &edgeTime, &edgeDuration );
-    unsigned long startTimestamp = edgeTime;
-    unsigned long endTimestamp = edgeTime;
-    unsigned long timeWindow = ULONG_MAX;
-    lines[0] = std::string( line );
-    // Read rest of the rows
-    for( int r=1; r<rows; r++ )
+        const std::vector<int> &nodes1 = chunk._columns[0]._labels;
+        const std::vector<int> &nodes2 = chunk._columns[1]._labels;
+        const std::vector<unsigned long> &times = chunk._columns[2]._integers;
+        const std::vector<unsigned long> &durations = chunk._columns[3]._integers;
+        for( size_t r=0; r<chunk._rows; r++ )
+        {
+            c._node1 = ids[nodes1[r]];
+            c._node2 = ids[nodes2[r]];
+            if( c._node1 < 0 || c._node2 < 0 || c._node1 == c._node2 )
+            {
+                numInvalid++;
+                continue;
+            }
+            if( !_directed && c._node2 < c._node1 )
+                std::swap( c._node1, c._node2 );
+            c._time = times[r];
+            c._duration = durations[r];
+            c._row = (int)contacts.size();
+            contacts.push_back( c );
+
+            // Attributes, missing or invalid values are zero
+            for( int a=0; a<numAttributes; a++ )
+                values.push_back( chunk._columns[4+a]._reals[r] );
+
+            // Min, max and window
+            if( c._time < startTimestamp )
+                startTimestamp = c._time;
+            if( c._time + c._duration > endTimestamp )
+                endTimestamp = c._time + c._duration;
+            if( c._duration > 0 && c._duration < timeWindow )
+                timeWindow = c._duration;
+        }
+    }
+    if( fm_.status() != mk_file_manager::Ok )
+        _log.w( "create", "reading stopped at byte %lu, using contacts read so far",
+                (unsigned long)fm_.offset() );
+    if( addNodes_ )
+        _log.i( "create", "number of nodes:   %i", order() );
+    if( contacts.empty() )
     {
-        strcpy(line, fm.get_line().c_str());
-        sscanf( line, "%s %s %lu %lu", node1Label, node2Label, &edgeTime, &edgeDuration );
-        lines[r] = std::string( line );
+        _log.e( "create", "no valid contacts" );
+        return false;
+    }
+    if( timeWindow == ULONG_MAX )
+        timeWindow = 1;
+    _pending._invalid = numInvalid;
+    _pending._start = startTimestamp;
+    _pending._end = endTimestamp;
+    _pending._window = timeWindow;
+    return true;
+}
 
-        // Get min, max and window
-        if( edgeTime < startTimestamp )
-            startTimestamp = edgeTime;
-        if( edgeTime + edgeDuration > endTimestamp )
-            endTimestamp = edgeTime + edgeDuration;
-        if( edgeDuration < timeWindow )
-            timeWindow = edgeDuration;
+bool meerkat::mk_temporal_network::_build_edges( bool reverseTime_ )
+{
+    std::vector<__contact> contacts;
+    std::vector<double> values;
+    contacts.swap( _pending._contacts );
+    values.swap( _pending._values );
+    int numAttributes = attributes(), numInvalid = _pending._invalid;
+    unsigned long startTimestamp = _pending._start, endTimestamp = _pending._end;
+    unsigned long timeWindow = _pending._window;
+    __contact c;
+
+    // Use fixed time frame if set
+    if( _isFrameSet )
+    {
+        startTimestamp = _frameStart;
+        endTimestamp = _frameEnd;
+        timeWindow = _frameWindow;
     }
 
     // Calculate number of time steps
@@ -286,179 +656,220 @@ bool meerkat::mk_temporal_network::create( const std::string filename_,
     _log.i( "create", "time window:       %lu", timeWindow );
     _log.i( "create", "max time index:    %i", _maxTime );
 
-    /// Add nodes
-    int numLines = (int)lines.size();
-    for( int i=0; i<numLines; i++ )
+    /// Convert to time indices and clip to horizon
+    int numContacts = (int)contacts.size(), length = _maxTime+1, numClipped = 0, k = 0;
+    long long start, end, duration;
+    for( int i=0; i<numContacts; i++ )
     {
-        sscanf( lines[i].c_str(), "%s %s %lu %lu",
-                node1Label, node2Label, &edgeTime, &edgeDuration );
-        _add_node( std::string(node1Label) );
-        _add_node( std::string(node2Label) );
-    }
-    _log.i( "create", "number of nodes:   %i", order() );
-
-    /// Read in activity patterns
-    std::map<std::pair<int, int>, std::vector<bool> > activities;
-    std::map<std::pair<int, int>, std::vector<bool> >::iterator it;
-    int node1Id, node2Id, sNode1Id, sNode2Id, timeIdx, timeDur;
-    for( int i=0; i<numLines;i++ )
-    {
-        // Get node ids and time index
-        sscanf( lines[i].c_str(), "%s %s %lu %lu",
-                node1Label, node2Label, &edgeTime, &edgeDuration );
-        node1Id = node_id( node1Label );
-        node2Id = node_id( node2Label );
-        timeIdx = int((edgeTime-startTimestamp) / timeWindow);
-        timeDur = int(edgeDuration / timeWindow);
-        if( timeDur == 0 )
-            timeDur = 1;
+        c = contacts[i];
+        if( c._time < startTimestamp )
+        {
+            numClipped++;
+            continue;
+        }
+        start = (long long)((c._time - startTimestamp) / timeWindow);
+        duration = (long long)(c._duration / timeWindow);
+        if( duration == 0 )
+            duration = 1;
+        end = start + duration;
 
         // Reverse if it is enabled
         if( reverseTime_ )
-            timeIdx = _maxTime - (timeIdx + timeDur) + 1;
-
-        // Sorted node ids
-        sNode1Id = node1Id < node2Id ? node1Id : node2Id;
-        sNode2Id = node1Id < node2Id ? node2Id : node1Id;
+        {
+            start = _maxTime - end + 1;
+            end = start + duration;
+        }
 
-        // Add activity if edge is new
-        if( activities.find( std::pair<int, int>(sNode1Id, sNode2Id) ) == activities.end() )
-            activities[std::pair<int, int>(sNode1Id, sNode2Id)] =
-                    std::vector<bool>( _maxTime+1, false );
-        // Set timestamp to true
-        for( int ti=0; ti<timeDur; ti++ )
-            activities[std::pair<int, int>(sNode1Id, sNode2Id)][timeIdx+ti] = true;
+        // Clip
+        if( start < 0 || end > length )
+        {
+            numClipped++;
+            start = start < 0 ? 0 : start;
+            end = end > length ? length : end;
+            if( start >= end )
+                continue;
+        }
+        c._start = (int)start;
+        c._end = (int)end;
+        contacts[k++] = c;
+    }
+    contacts.resize( k );
+    numContacts = k;
+
+    /// Sort and merge contacts of the same node pair into intervals
+    _sort_contacts( contacts );
+    std::vector<int> rowInterval( values.size() / (numAttributes > 0 ? numAttributes : 1), -1 );
+    int numDuplicates = 0, numOverlaps = 0;
+    __contact prev;
+    k = 0;
+    for( int i=0; i<numContacts; i++ )
+    {
+        c = contacts[i];
+        if( k > 0 && contacts[k-1]._node1 == c._node1 && contacts[k-1]._node2 == c._node2
+                && c._start <= contacts[k-1]._end )
+        {
+            // Merge in previous interval (adjacent contacts are merged silently)
+            if( c._start == prev._start && c._end == prev._end )
+                numDuplicates++;
+            else if( c._start < contacts[k-1]._end )
+                numOverlaps++;
+            if( c._end > contacts[k-1]._end )
+                contacts[k-1]._end = c._end;
+        }
+        else
+            contacts[k++] = c;
+        prev = c;
+        if( numAttributes > 0 )
+            rowInterval[c._row] = k-1;
     }
+    contacts.resize( k );
+    if( numInvalid > 0 )
+        _log.w( "create", "invalid rows:      %i (dropped)", numInvalid );
+    if( numClipped > 0 )
+        _log.w( "create", "clipped contacts:  %i", numClipped );
+    if( numDuplicates > 0 )
+        _log.w( "create", "duplicates:        %i (merged)", numDuplicates );
+    if( numOverlaps > 0 )
+        _log.w( "create", "overlaps:          %i (merged)", numOverlaps );
 
     /// Add edges
-    for( it=activities.begin(); it!=activities.end(); it++ )
+    int numIntervals = (int)contacts.size(), first = 0;
+    __activity *activity;
+    for( int i=1; i<=numIntervals; i++ )
     {
-        node1Id = it->first.first;
-        node2Id = it->first.second;
-        _add_edge( node1Id, node2Id, it->second );
+        if( i == numIntervals || contacts[i]._node1 != contacts[first]._node1
+                || contacts[i]._node2 != contacts[first]._node2 )
+        {
+            activity = new __activity( length, _compact );
+            for( int j=first; j<i; j++ )
+                activity->push( contacts[j]._start, contacts[j]._end - contacts[j]._start );
+            activity->shrink();
+            _add_edge( contacts[first]._node1, contacts[first]._node2, activity );
+            first = i;
+        }
     }
     _log.i( "create", "number of edges:   %i", size() );
+    _log.i( "create", "interval storage:  %lu bytes", interval_bytes() );
+
+    /// Add attributes to the intervals they fall in
+    _attributes.assign( numAttributes, std::vector<double>(_numIntervals, 0.0) );
+    int numRows = (int)rowInterval.size();
+    for( int r=0; r<numRows; r++ )
+    {
+        if( rowInterval[r] >= 0 )
+        {
+            for( int a=0; a<numAttributes; a++ )
+                _attributes[a][rowInterval[r]] += values[r*numAttributes + a];
+        }
+    }
+    _log.i( "create", "attributes:        %i", attributes() );
 
     /// Init time
     set_clock( 0 );
     return true;
 }
 
+bool meerkat::mk_temporal_network::_read_edges( mk_file_manager &fm_,
+                                                bool addNodes_,
+                                                bool reverseTime_ )
+{
+    return _read_contacts( fm_, addNodes_ ) && _build_edges( reverseTime_ );
+}
+
+meerkat::mk_temporal_network::mk_temporal_network()
+{
+    _currentTime = 0;
+    _maxTime = 0;
+    _compact = false;
+    _directed = false;
+    _numIntervals = 0;
+    _labels = new __labels();
+    _sharedLabels = false;
+    _isFrameSet = false;
+    _frameStart = 0;
+    _frameEnd = 0;
+    _frameWindow = 0;
+    _pending._invalid = 0;
+    _pending._start = 0;
+    _pending._end = 0;
+    _pending._window = 0;
+    _trackSwitches = false;
+    _log.tag( "mk_temporal_network" );
+}
+
+meerkat::mk_temporal_network::~mk_temporal_network()
+{
+    destroy();
+    if( !_sharedLabels )
+        delete _labels;
+}
+
+void meerkat::mk_temporal_network::set_compact( bool compact_ )
+{
+    if( order() > 0 )
+    {
+        _log.w( "set_compact", "network is already created" );
+        return;
+    }
+    _compact = compact_;
+}
+
+void meerkat::mk_temporal_network::set_directed( bool directed_ )
+{
+    if( order() > 0 )
+    {
+        _log.w( "set_directed", "network is already created" );
+        return;
+    }
+    _directed = directed_;
+}
+
+bool meerkat::mk_temporal_network::create( const std::string filename_,
+                                           bool reverseTime_ )
+{
+    /// Try to open file.
+    mk_file_manager fm;
+    if( !fm.map(filename_) )
+    {
+        _log.e( "create", "no such file: '%s'", filename_.c_str() );
+        return false;
+    }
+
+    /// Read nodes and edges
+    return _read_edges( fm, true, reverseTime_ );
+}
+
 bool meerkat::mk_temporal_network::create(const std::string nodesFile_,
                                            const std::string edgesFile_,
                                            bool reverseTime_ )
 {
     /// Check if nodes file exists
     mk_file_manager fn, fe;
-    if( !(fn.read(nodesFile_)) )
+    if( !(fn.map(nodesFile_)) )
     {
         _log.e( "create", "no such file: '%s'", nodesFile_.c_str() );
         return false;
     }
-    if( !(fe.read(edgesFile_)) )
+    if( !(fe.map(edgesFile_)) )
     {
         _log.e( "create", "no such file: '%s'", edgesFile_.c_str() );
         return false;
     }
 
     /// Read nodes
-    int rows = fn.rows();
-    char line[1024] = {""}, nodeLabel[128] = {""};
-    fn.get_line();
-    for( int r=1; r<rows; r++ )
+    mk_file_manager::mk_line span, label;
+    const char *pos;
+    fn.next_line( span );
+    while( fn.next_line(span) )
     {
-        sscanf( fn.get_line().c_str(), "%s", nodeLabel );
-        _add_node( std::string(nodeLabel) );
+        pos = span._data;
+        if( mk_file_manager::parse_token(pos, span._data + span._size, label) )
+            _add_node( label.str() );
     }
     _log.i( "create", "number of nodes:   %i", order() );
 
     /// Read edges
-    rows = fe.rows() - 1;
-
-    // Determine min and max times (also take lines)
-    std::vector<std::string> lines( rows, "" );
-    char node1Label[128] = {""}, node2Label[128] = {""};
-    unsigned long edgeTime = 0, edgeDuration = 0;
-
-    // Eat up header
-    fe.get_line();
-
-    // Set start and end timestamp initial values
-    strcpy( line, fe.get_line().c_str() );
-    sscanf( line, "%s %s %lu %lu", node1Label, node2Label, &edgeTime, &edgeDuration );
-    unsigned long startTimestamp = edgeTime;
-    unsigned long endTimestamp = edgeTime;
-    unsigned long timeWindow = ULONG_MAX;
-    lines[0] = std::string( line );
-    // Read rest of the rows
-    for( int r=1; r<rows; r++ )
-    {
-        strcpy( line, fe.get_line().c_str() );
-        sscanf( line, "%s %s %lu %lu", node1Label, node2Label, &edgeTime, &edgeDuration );
-        lines[r] = std::string( line );
-
-        // Get min, max and window
-        if( edgeTime < startTimestamp )
-            startTimestamp = edgeTime;
-        if( edgeTime + edgeDuration > endTimestamp )
-            endTimestamp = edgeTime + edgeDuration;
-        if( edgeDuration < timeWindow )
-            timeWindow = edgeDuration;
-    }
-    // Calculate number of time steps
-    _maxTime = int((endTimestamp - startTimestamp) / timeWindow);
-    if( _maxTime == 0 )
-        _maxTime = 1;
-    _timeWindow = (int)timeWindow;
-    _log.i( "create", "start time:        %lu", startTimestamp );
-    _log.i( "create", "end time:          %lu", endTimestamp );
-    _log.i( "create", "time window:       %lu", timeWindow );
-    _log.i( "create", "max time index:    %i", _maxTime );
-
-    /// Read in activity patterns
-    int numLines = (int)lines.size();
-    std::map<std::pair<int, int>, std::vector<bool> > activities;
-    std::map<std::pair<int, int>, std::vector<bool> >::iterator it;
-    int node1Id, node2Id, sNode1Id, sNode2Id, timeIdx, timeDur;
-    for( int i=0; i<numLines;i++ )
-    {
-        // Get node ids and time index
-        sscanf( lines[i].c_str(), "%s %s %lu %lu",
-                node1Label, node2Label, &edgeTime, &edgeDuration );
-        node1Id = node_id( node1Label );
-        node2Id = node_id( node2Label );
-        timeIdx = int((edgeTime-startTimestamp) / timeWindow);
-        timeDur = int(edgeDuration / timeWindow);
-
-        // Reverse if it is enabled
-        if( reverseTime_ )
-            timeIdx = _maxTime - (timeIdx + timeDur) + 1;
-
-        // Sorted node ids
-        sNode1Id = node1Id < node2Id ? node1Id : node2Id;
-        sNode2Id = node1Id < node2Id ? node2Id : node1Id;
-
-        // Add activity if edge is new
-        if( activities.find( std::pair<int, int>(sNode1Id, sNode2Id) ) == activities.end() )
-            activities[std::pair<int, int>(sNode1Id, sNode2Id)] =
-                    std::vector<bool>( _maxTime, false );
-        // Set timestamp to true
-        for( int ti=0; ti<timeDur; ti++ )
-            activities[std::pair<int, int>(sNode1Id, sNode2Id)][timeIdx+ti] = true;
-    }
-
-    /// Add edges
-    for( it=activities.begin(); it!=activities.end(); it++ )
-    {
-        node1Id = it->first.first;
-        node2Id = it->first.second;
-        _add_edge( node1Id, node2Id, it->second );
-    }
-    _log.i( "create", "number of edges:   %i", size() );
-
-    /// Init time
-    set_clock( 0 );
-    return true;
+    return _read_edges( fe, false, reverseTime_ );
 }
 
 bool meerkat::mk_temporal_network::destroy()
@@ -472,10 +883,24 @@ bool meerkat::mk_temporal_network::destroy()
             deg = degree(i);
             for( int j=0; j<deg; j++ )
                 delete _nodes[i]->_neighbors[j];
+            deg = (int)_nodes[i]->_inNeighbors.size();
+            for( int j=0; j<deg; j++ )
+                delete _nodes[i]->_inNeighbors[j];
             delete _nodes[i];
         }
+        int numActivities = (int)_activities.size();
+        for( int i=0; i<numActivities; i++ )
+            delete _activities[i];
         _nodes.clear();
-        _labelsHash.clear();
+        _activities.clear();
+        if( !_sharedLabels )
+        {
+            _labels->_labels.clear();
+            _labels->_hash.clear();
+        }
+        _attributeNames.clear();
+        _attributes.clear();
+        _numIntervals = 0;
         _log.i( "destroy", "network is destroyed" );
         return true;
     }
@@ -489,7 +914,7 @@ const std::string *meerkat::mk_temporal_network::label( int nodeId_ ) const
 {
     // Check node id
     if( _is_node_id_valid(nodeId_) )
-        return &_nodes[nodeId_]->_label;
+        return &_labels->_labels[nodeId_];
     else
     {
         _log.w( "label", "invalid node id" );
@@ -556,7 +981,150 @@ int meerkat::mk_temporal_network::active_neighbor( int nodeId_, int neighborId_
         return -1;
     }
 
-    return _nodes[nodeId_]->_activeNeighbors[neighborId_]->_id;
+    return _nodes[nodeId_]->_activeNeighbors[neighborId_]->_ptr->_id;
+}
+
+int meerkat::mk_temporal_network::in_degree( int nodeId_ ) const
+{
+    // Check node id
+    if( _is_node_id_valid(nodeId_) )
+        return (int)_in_edges(nodeId_).size();
+    else
+    {
+        _log.w( "in_degree", "invalid node id" );
+        return 0;
+    }
+}
+
+int meerkat::mk_temporal_network::active_in_degree( int nodeId_ ) const
+{
+    // Check node id
+    if( _is_node_id_valid(nodeId_) )
+        return (int)_active_in_neighbors(nodeId_).size();
+    else
+    {
+        _log.w( "active_in_degree", "invalid node id" );
+        return 0;
+    }
+}
+
+int meerkat::mk_temporal_network::in_neighbor( int nodeId_, int neighborId_ ) const
+{
+    // Check node id
+    if( !_is_node_id_valid(nodeId_) )
+    {
+        _log.w( "in_neighbor", "invalid node id" );
+        return -1;
+    }
+
+    // Check neighbor id
+    if( neighborId_ < 0 || neighborId_ >= in_degree(nodeId_) )
+    {
+        _log.w( "in_neighbor", "invalid neighbor id" );
+        return -1;
+    }
+
+    return _in_edges(nodeId_)[neighborId_]->_ptr->_id;
+}
+
+int meerkat::mk_temporal_network::active_in_neighbor( int nodeId_, int neighborId_ ) const
+{
+    // Check node id
+    if( !_is_node_id_valid(nodeId_) )
+    {
+        _log.w( "active_in_neighbor", "invalid node id" );
+        return -1;
+    }
+
+    // Check neighbor id
+    if( neighborId_ < 0 || neighborId_ >= active_in_degree(nodeId_) )
+    {
+        _log.w( "active_in_neighbor", "invalid neighbor id" );
+        return -1;
+    }
+
+    return _active_in_neighbors(nodeId_)[neighborId_]->_ptr->_id;
+}
+
+double meerkat::mk_temporal_network::active_attribute( int nodeId_, int neighborId_,
+                                                      int attributeId_ ) const
+{
+    // Check node id
+    if( !_is_node_id_valid(nodeId_) )
+    {
+        _log.w( "active_attribute", "invalid node id" );
+        return 0.0;
+    }
+
+    // Check neighbor id
+    if( neighborId_ < 0 || neighborId_ >= active_degree(nodeId_) )
+    {
+        _log.w( "active_attribute", "invalid neighbor id" );
+        return 0.0;
+    }
+
+    // Check attribute id
+    if( attributeId_ < 0 || attributeId_ >= attributes() )
+    {
+        _log.w( "active_attribute", "invalid attribute id" );
+        return 0.0;
+    }
+
+    // Current appearance precedes the next one the cursor points to
+    __edge *edge = _nodes[nodeId_]->_activeNeighbors[neighborId_];
+    return _attributes[attributeId_][edge->_activity->_offset + edge->_cursor._index - 1];
+}
+
+void meerkat::mk_temporal_network::earliest_arrival( int nodeId_,
+                                                     std::vector<int> &arrivals_ ) const
+{
+    arrivals_.assign( order(), -1 );
+    if( !_is_node_id_valid(nodeId_) )
+    {
+        _log.w( "earliest_arrival", "invalid node id" );
+        return;
+    }
+
+    // Dijkstra search over arrival times, ordered by earliest arrival
+    std::priority_queue<std::pair<int, int>,
+            std::vector<std::pair<int, int> >,
+            std::greater<std::pair<int, int> > > queue;
+    std::vector<bool> done( order(), false );
+    arrivals_[nodeId_] = _currentTime;
+    queue.push( std::pair<int, int>(_currentTime, nodeId_) );
+    __cursor cursor;
+    __edge *edge;
+    int node, arrival, t, deg;
+    while( !queue.empty() )
+    {
+        arrival = queue.top().first;
+        node = queue.top().second;
+        queue.pop();
+        if( done[node] )
+            continue;
+        done[node] = true;
+
+        // Find first activation of each (out-)edge not earlier than arrival
+        deg = (int)_nodes[node]->_neighbors.size();
+        for( int j=0; j<deg; j++ )
+        {
+            edge = _nodes[node]->_neighbors[j];
+            if( edge->_activity->seek(cursor, arrival) > 0 )
+                t = arrival;
+            else if( cursor._duration > 0 )
+                t = cursor._start;
+            else
+                continue;
+
+            // Transmit to neighbor in the next time step
+            if( t+1 < _maxTime
+                    && (arrivals_[edge->_ptr->_id] < 0 || t+1 < arrivals_[edge->_ptr->_id]) )
+            {
+                arrivals_[edge->_ptr->_id] = t+1;
+                queue.push( std::pair<int, int>(t+1, edge->_ptr->_id) );
+            }
+        }
+    }
 }
 
 void meerkat::mk_temporal_network::active_edges( std::vector<std::pair<int, int> > &edges_ ) const
@@ -569,7 +1137,7 @@ void meerkat::mk_temporal_network::active_edges( std::vector<std::pair<int, int>
         for( int j=0; j<deg; j++ )
         {
             ni = active_neighbor(i, j);
-            if( ni > i )
+            if( _directed || ni > i )
             {
                 edges_[k] = std::pair<int, int>( i, ni );
                 k++;
@@ -578,6 +1146,34 @@ void meerkat::mk_temporal_network::active_edges( std::vector<std::pair<int, int>
     }
 }
 
+int meerkat::mk_temporal_network::attributes() const
+{
+    return (int)_attributeNames.size();
+}
+
+const std::string *meerkat::mk_temporal_network::attribute_name( int attributeId_ ) const
+{
+    // Check attribute id
+    if( attributeId_ >= 0 && attributeId_ < attributes() )
+        return &_attributeNames[attributeId_];
+    else
+    {
+        _log.w( "attribute_name", "invalid attribute id" );
+        return NULL;
+    }
+}
+
+int meerkat::mk_temporal_network::attribute_id( std::string name_ ) const
+{
+    int numAttributes = attributes();
+    for( int a=0; a<numAttributes; a++ )
+    {
+        if( _attributeNames[a] == name_ )
+            return a;
+    }
+    return -1;
+}
+
 int meerkat::mk_temporal_network::time() const
 {
     return _currentTime;
@@ -603,7 +1199,7 @@ int meerkat::mk_temporal_network::size() const
     int o = order(), s = 0;
     for( int i=0; i<o; i++ )
         s += degree(i);
-    return s / 2;
+    return _directed ? s : s / 2;
 }
 
 double meerkat::mk_temporal_network::k() const
@@ -611,23 +1207,31 @@ double meerkat::mk_temporal_network::k() const
     return 2.0 * (double)size_temporal() / ((double)_maxTime * (double)_nodes.size());
 }
 
+bool meerkat::mk_temporal_network::directed() const
+{
+    return _directed;
+}
+
+bool meerkat::mk_temporal_network::compact() const
+{
+    return _compact;
+}
+
+unsigned long meerkat::mk_temporal_network::interval_bytes() const
+{
+    int numActivities = (int)_activities.size();
+    unsigned long b = 0;
+    for( int i=0; i<numActivities; i++ )
+        b += _activities[i]->bytes();
+    return b;
+}
+
 int meerkat::mk_temporal_network::size_temporal() const
 {
-    int o = order(), s = 0, deg, length;
-    for( int i=0; i<o; i++ )
-    {
-        deg = degree(i);
-        for( int j=0; j<deg; j++ )
-        {
-            length = (int)_nodes[i]->_neighbors[j]->_durations.size();
-            for( int e=0; e<length; e++ )
-            {
-                if( _nodes[i]->_neighbors[j]->_durations[e] > 0 )
-                    s += _nodes[i]->_neighbors[j]->_durations[e];
-            }
-        }
-    }
-    return s/2;
+    int numActivities = (int)_activities.size(), s = 0;
+    for( int i=0; i<numActivities; i++ )
+        s += _activities[i]->_total;
+    return s;
 }
 
 int meerkat::mk_temporal_network::active_size() const
@@ -635,7 +1239,7 @@ int meerkat::mk_temporal_network::active_size() const
     int o = order(), s = 0;
     for( int i=0; i<o; i++ )
         s += active_degree(i);
-    return s / 2;
+    return _directed ? s : s / 2;
 }
 
 void meerkat::mk_temporal_network::set_clock(const int time_)
@@ -649,9 +1253,26 @@ void meerkat::mk_temporal_network::set_clock(const int time_)
 void meerkat::mk_temporal_network::update_clock()
 {
     int o = order();
+    _switches.clear();
     _currentTime = (_currentTime+1) % _maxTime;
     if( _currentTime == 0 )
         set_clock( 0 );
+    else if( _trackSwitches )
+    {
+        // Record switches of incoming edges
+        __node *node;
+        for( int i=0; i<o; i++ )
+        {
+            node = _nodes[i];
+            __node::update_clock( node->_neighbors, node->_activeNeighbors,
+                                  _directed ? NULL : &_switched );
+            __node::update_clock( node->_inNeighbors, node->_activeInNeighbors,
+                                  _directed ? &_switched : NULL );
+            for( int j=0; j<(int)_switched.size(); j++ )
+                _switches.push_back( std::make_pair(i, _switched[j]) );
+            _switched.clear();
+        }
+    }
     else
     {
         for( int i=0; i<o; i++ )
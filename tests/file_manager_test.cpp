@@ -0,0 +1,573 @@
+/* meerkat file manager test.
+ *
+ * Round-trip checks and timings of the mk_file_manager parsers. Without arguments the checks
+ * are run (exit status is non-zero if any fails), with "bench" the timings are printed.
+ */
+
+#include "meerkat_file_manager.hpp"
+#include "meerkat_random_generator.hpp"
+#include <cmath>
+#include <chrono>
+
+using namespace meerkat;
+
+
+// number of failed checks
+static int _failures = 0;
+
+// keeps benchmarked results alive
+static volatile double _sink = 0.0;
+
+
+/**
+ * @brief _check       Prints the outcome of a check and counts failures.
+ * @param passed_      Outcome.
+ * @param name_        Name of the check.
+ * @param value_       Measured value.
+ * @param limit_       Limit of the value.
+ */
+static void _check( bool passed_, const char *name_, double value_, double limit_ )
+{
+    printf( "  %-52s %12.6g  (limit %.6g)  %s\n", name_, value_, limit_, passed_ ? "ok" : "FAILED" );
+    if( !passed_ )
+        _failures++;
+}
+
+/**
+ * @brief _contents   Reads a whole file.
+ * @param fileName_   File name.
+ * @return            Contents of the file, empty if it cannot be read.
+ */
+static std::string _contents( const std::string &fileName_ )
+{
+    std::string contents;
+    FILE *file = fopen( fileName_.c_str(), "rb" );
+    if( file == NULL )
+        return contents;
+    char buffer[65536];
+    size_t size;
+    while( (size = fread(buffer, 1, sizeof(buffer), file)) > 0 )
+        contents.append( buffer, size );
+    fclose( file );
+    return contents;
+}
+
+/**
+ * @brief _fprintf_rows  Writes rows as the former put() did: "%lg" for the first value, " %lg"
+ *                       for the rest and a line break.
+ * @param fileName_      File name.
+ * @param rows_          Rows to write, none of them empty.
+ * @param precision_     Number of significant digits (6 for "%lg").
+ */
+static void _fprintf_rows( const std::string &fileName_,
+                           const std::vector<std::vector<double> > &rows_, int precision_ )
+{
+    FILE *file = fopen( fileName_.c_str(), "w" );
+    for(size_t r=0; r<rows_.size(); r++)
+    {
+        fprintf( file, "%.*lg", precision_, rows_[r][0] );
+        for(size_t c=1; c<rows_[r].size(); c++)
+            fprintf( file, " %.*lg", precision_, rows_[r][c] );
+        fprintf( file, "\n" );
+    }
+    fclose( file );
+}
+
+/**
+ * @brief _seconds  Returns the time elapsed since a time point.
+ * @param start_    Start time.
+ * @return          Elapsed time in seconds.
+ */
+static double _seconds( const std::chrono::steady_clock::time_point &start_ )
+{
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - start_ ).count();
+}
+
+
+// checks
+
+/**
+ * @brief _check_fields  Parses lines whose fields start and end around the 16-byte blocks
+ *                       scanned with SSE2: blanks of 0-17 characters (spaces, tabs and carriage
+ *                       returns) before fields of 1-40 characters, with and without a comma
+ *                       separator. Each line is copied to a buffer of its own size followed by
+ *                       a field character, so a parser reading past the end of the line would
+ *                       return a longer field.
+ */
+static void _check_fields()
+{
+    const char blanks[3] = {' ', '\t', '\r'};
+    const char separators[2] = {' ', ','};
+    long tokenErrors = 0, intErrors = 0, ulongErrors = 0, doubleErrors = 0;
+    long emptyErrors = 0;
+    printf( "Fields\n" );
+
+    std::string line;
+    std::vector<char> buffer;
+    for(int s=0; s<2; s++)
+        for(int b=0; b<=17; b++)
+            for(int length=1; length<=40; length++)
+            {
+                char separator = separators[s];
+                std::string lead, gap;
+                for(int i=0; i<b; i++)
+                    lead += blanks[i % 3];
+                gap = separator == ',' ? lead + "," + lead : lead + " ";
+
+                // a token, an integer, an unsigned long and a double of the given length
+                std::string token( length, 'a' ), digits, number;
+                for(int i=0; i<length; i++)
+                    token[i] = (char)('a' + i % 26);
+                for(int i=0; i<length && i<18; i++)
+                    digits += (char)('1' + i % 9);
+                number = digits.substr( 0, std::min(length, 17) );
+                if( number.size() > 2 )
+                    number[1] = '.';
+                line = lead + token + gap + "-" + digits.substr(0, 9) + gap + digits + gap
+                       + number + lead;
+
+                buffer.assign( line.begin(), line.end() );
+                buffer.push_back( 'z' );
+                const char *pos = &buffer[0], *end = pos + line.size();
+                mk_file_manager::mk_line field;
+                int i;
+                unsigned long ul;
+                double d;
+
+                if( !mk_file_manager::parse_token(pos, end, field, separator)
+                        || field.str() != token )
+                    tokenErrors++;
+                if( !mk_file_manager::parse_int(pos, end, i, separator)
+                        || i != -atoi(digits.substr(0, 9).c_str()) )
+                    intErrors++;
+                if( !mk_file_manager::parse_ulong(pos, end, ul, separator)
+                        || ul != strtoul(digits.c_str(), NULL, 10) )
+                    ulongErrors++;
+                if( !mk_file_manager::parse_double(pos, end, d, separator)
+                        || d != strtod(number.c_str(), NULL) )
+                    doubleErrors++;
+                if( mk_file_manager::parse_token(pos, end, field, separator) )
+                    emptyErrors++;
+
+                // the same token at the end of the line, without trailing blanks
+                line = lead + token;
+                buffer.assign( line.begin(), line.end() );
+                buffer.push_back( 'z' );
+                pos = &buffer[0];
+                end = pos + line.size();
+                if( !mk_file_manager::parse_token(pos, end, field, separator)
+                        || field.str() != token || pos != end )
+                    tokenErrors++;
+            }
+    _check( tokenErrors == 0, "parse_token wrong fields", tokenErrors, 0 );
+    _check( intErrors == 0, "parse_int wrong fields", intErrors, 0 );
+    _check( ulongErrors == 0, "parse_ulong wrong fields", ulongErrors, 0 );
+    _check( doubleErrors == 0, "parse_double wrong fields", doubleErrors, 0 );
+    _check( emptyErrors == 0, "fields found after the last one", emptyErrors, 0 );
+
+    // invalid and limit values, an empty field between two separators ends the line
+    struct { const char *text; char separator; int kind; bool valid; double value; } cases[] = {
+        {"2147483647", ' ', 0, true, 2147483647.0},
+        {"-2147483648", ' ', 0, true, -2147483648.0},
+        {"2147483648", ' ', 0, false, 0.0},
+        {"12a", ' ', 0, false, 0.0},
+        {"+7,", ',', 0, true, 7.0},
+        {"-", ' ', 0, false, 0.0},
+        {"18446744073709551615", ' ', 1, true, 18446744073709551615.0},
+        {"18446744073709551616", ' ', 1, false, 0.0},
+        {"-1", ' ', 1, false, 0.0},
+        {"1234567890123456789012345", ' ', 1, false, 0.0},
+        {"+2.5e-3", ' ', 2, true, 2.5e-3},
+        {"1e", ' ', 2, false, 0.0},
+        {"0x10", ' ', 2, false, 0.0},
+        {",5", ',', 2, true, 5.0},
+        {",,5", ',', 2, false, 0.0},
+        {" \t,\r 5", ',', 2, true, 5.0}
+    };
+    long caseErrors = 0;
+    for(size_t c=0; c<sizeof(cases)/sizeof(cases[0]); c++)
+    {
+        const char *pos = cases[c].text, *end = pos + strlen( pos );
+        bool valid;
+        double value = 0.0;
+        int i;
+        unsigned long ul;
+        switch( cases[c].kind )
+        {
+        case 0:
+            valid = mk_file_manager::parse_int( pos, end, i, cases[c].separator );
+            value = i;
+            break;
+        case 1:
+            valid = mk_file_manager::parse_ulong( pos, end, ul, cases[c].separator );
+            value = (double)ul;
+            break;
+        default:
+            valid = mk_file_manager::parse_double( pos, end, value, cases[c].separator );
+            break;
+        }
+        if( valid != cases[c].valid || (valid && value != cases[c].value) )
+        {
+            printf( "  unexpected result for '%s'\n", cases[c].text );
+            caseErrors++;
+        }
+    }
+    _check( caseErrors == 0, "limit and invalid values", caseErrors, 0 );
+}
+
+/**
+ * @brief _check_doubles  Checks that parse_double() gives the same double as strtod() for random
+ *                        bit patterns printed with %.17g, %.15g, %g and %e, for random decimal
+ *                        strings of up to 25 digits, for halfway cases above 2^53 and for the
+ *                        smallest subnormal.
+ */
+static void _check_doubles()
+{
+    const int n = 1000000;
+    const char *formats[4] = {"%.17g", "%.15g", "%g", "%e"};
+    long mismatches = 0;
+    char text[128];
+    printf( "Doubles\n" );
+
+    mk_random_generator rg( 42, mk_random_generator::Xoshiro256 );
+    for(int i=0; i<n; i++)
+    {
+        // random finite bit pattern, including subnormals
+        uint64_t bits = rg.bits64();
+        double x;
+        memcpy( &x, &bits, sizeof(x) );
+        if( !std::isfinite(x) )
+            continue;
+        snprintf( text, sizeof(text), formats[i % 4], x );
+        double expected = strtod( text, NULL ), value;
+        const char *pos = text;
+        if( !mk_file_manager::parse_double(pos, text + strlen(text), value)
+                || memcmp(&value, &expected, sizeof(value)) != 0 )
+            mismatches++;
+    }
+    _check( mismatches == 0, "random bit patterns differing from strtod", mismatches, 0 );
+
+    mismatches = 0;
+    for(int i=0; i<n; i++)
+    {
+        // random decimal digits with a random point and exponent
+        int digits = rg.integer_uniform( 1, 25 ), point = rg.integer_uniform( 0, digits ), len = 0;
+        for(int d=0; d<digits; d++)
+        {
+            if( d == point && d > 0 )
+                text[len++] = '.';
+            text[len++] = (char)('0' + rg.integer_uniform( 0, 9 ));
+        }
+        len += snprintf( text+len, sizeof(text)-len, "e%d", rg.integer_uniform(-300, 300) );
+        double expected = strtod( text, NULL ), value;
+        const char *pos = text;
+        if( !std::isfinite(expected) )
+            continue;
+        if( !mk_file_manager::parse_double(pos, text + len, value)
+                || memcmp(&value, &expected, sizeof(value)) != 0 )
+            mismatches++;
+    }
+    _check( mismatches == 0, "random decimals differing from strtod", mismatches, 0 );
+
+    // 2^53 + 1 and 2^53 + 3 are halfway between two doubles (ties to even), the last one is
+    // the smallest subnormal
+    const char *halfway[4] = {"9007199254740993", "9007199254740995", "9007199254740993.0000000001",
+                              "4.9406564584124654e-324"};
+    mismatches = 0;
+    for(int i=0; i<4; i++)
+    {
+        double expected = strtod( halfway[i], NULL ), value;
+        const char *pos = halfway[i];
+        if( !mk_file_manager::parse_double(pos, halfway[i] + strlen(halfway[i]), value)
+                || memcmp(&value, &expected, sizeof(value)) != 0 )
+            mismatches++;
+    }
+    _check( mismatches == 0, "halfway cases differing from strtod", mismatches, 0 );
+}
+
+/**
+ * @brief _differing  Number of differing bytes of two strings (including the length difference).
+ * @param a_          First string.
+ * @param b_          Second string.
+ * @return            The number of differing bytes.
+ */
+static long _differing( const std::string &a_, const std::string &b_ )
+{
+    long differing = (long)(a_.size() > b_.size() ? a_.size() - b_.size() : b_.size() - a_.size());
+    for(size_t i=0; i<a_.size() && i<b_.size(); i++)
+        differing += a_[i] != b_[i];
+    return differing;
+}
+
+/**
+ * @brief _check_output  Checks that put() and both put_rows() write the same bytes as the former
+ *                       fprintf("%lg") path at the default precision, and as "%.*lg" for
+ *                       precisions 1-17. Rows of 1-5 values mix random bit patterns, uniform
+ *                       and normal values, integers, values where %g changes notation or rounds
+ *                       up (1e-5, 999999.5), zeros, extremes, infinities and NaN.
+ */
+static void _check_output()
+{
+    const int numRows = 20000, numCols = 5;
+    const double specials[16] = {0.0, -0.0, 1e-5, 9.99999e-5, 1e-4, 0.0001234565, 999999.5,
+                                 999999.4, 1e15, 123456789.0, -2.5, 4.9406564584124654e-324,
+                                 1.7976931348623157e308, HUGE_VAL, -HUGE_VAL, NAN};
+    const char *methods[3] = {"put", "put_rows (rows)", "put_rows (matrix)"};
+    const std::string expectedName = "file_manager_test_expected.txt";
+    const std::string outputName = "file_manager_test_output.txt";
+    char name[128];
+    printf( "Output\n" );
+
+    // the matrix holds full rows for the row-major put_rows(), rows_ has rows of 1-5 values
+    mk_random_generator rg( 42, mk_random_generator::Xoshiro256 );
+    std::vector<std::vector<double> > rows( numRows ), full( numRows );
+    std::vector<double> matrix;
+    for(int r=0; r<numRows; r++)
+        for(int c=0; c<numCols; c++)
+        {
+            double x;
+            uint64_t bits;
+            switch( rg.integer_uniform(0, 4) )
+            {
+            case 0:
+                bits = rg.bits64();
+                memcpy( &x, &bits, sizeof(x) );
+                break;
+            case 1:
+                x = rg.double_uniform( 0.0, 1.0 );
+                break;
+            case 2:
+                x = rg.double_normal( 0.0, 1000.0 );
+                break;
+            case 3:
+                x = rg.integer_uniform( -10000000, 10000000 );
+                break;
+            default:
+                x = specials[rg.integer_uniform( 0, 15 )];
+                break;
+            }
+            matrix.push_back( x );
+            full[r].push_back( x );
+            if( c <= r % numCols )
+                rows[r].push_back( x );
+        }
+
+    // precision 0 stands for the default, differences at precisions 1-17 are summed
+    long differing[3] = {0, 0, 0};
+    for(int precision=0; precision<=17; precision++)
+    {
+        for(int m=0; m<3; m++)
+        {
+            _fprintf_rows( expectedName, m < 2 ? rows : full, precision > 0 ? precision : 6 );
+            mk_file_manager fm;
+            fm.write( outputName );
+            if( precision > 0 )
+                fm.set_precision( precision );
+            if( m == 0 )
+                for(int r=0; r<numRows; r++)
+                    fm.put( rows[r] );
+            else if( m == 1 )
+                fm.put_rows( rows );
+            else
+                fm.put_rows( &matrix[0], numRows, numCols );
+            fm.close();
+
+            std::string expected = _contents( expectedName );
+            long d = expected.empty() ? 1 : _differing( _contents(outputName), expected );
+            if( precision == 0 )
+            {
+                sprintf( name, "%s bytes differing from %%lg", methods[m] );
+                _check( d == 0, name, d, 0 );
+            }
+            else
+                differing[m] += d;
+        }
+    }
+    for(int m=0; m<3; m++)
+    {
+        sprintf( name, "%s bytes differing from %%.{1-17}lg", methods[m] );
+        _check( differing[m] == 0, name, differing[m], 0 );
+    }
+    remove( expectedName.c_str() );
+    remove( outputName.c_str() );
+}
+
+// benchmarks
+
+/**
+ * @brief _bench_parsers  Prints the parsing speed of lines of an edge list (two labels, two
+ *                        times and two attributes), of integers and of doubles against the
+ *                        former sscanf()/strtod() path.
+ */
+static void _bench_parsers()
+{
+    const int n = 1000000;
+    mk_random_generator rg( 42, mk_random_generator::Xoshiro256 );
+    std::vector<std::string> texts( 3 );
+    char line[256];
+    for(int i=0; i<n; i++)
+    {
+        snprintf( line, sizeof(line), "node%d node%d %d %d %.6g %.17g\n", rg.integer_uniform(0, 99999),
+                  rg.integer_uniform(0, 99999), rg.integer_uniform(0, 1000000),
+                  rg.integer_uniform(1, 100), rg.double_uniform(0.0, 10.0),
+                  rg.double_normal(0.0, 1.0) );
+        texts[0] += line;
+        snprintf( line, sizeof(line), "%d\n", rg.integer_uniform(-1000000000, 1000000000) );
+        texts[1] += line;
+        snprintf( line, sizeof(line), "%.17g\n", rg.double_normal(0.0, 1000.0) );
+        texts[2] += line;
+    }
+
+    const char *names[3] = {"edge lines", "integers", "doubles (%.17g)"};
+    printf( "%-24s %14s %14s\n", "MB/s", "parse_*", "sscanf/strtod" );
+    for(int k=0; k<3; k++)
+    {
+        const char *begin = texts[k].c_str(), *end = begin + texts[k].size();
+        double mb = texts[k].size() / 1e6, seconds[2];
+        for(int m=0; m<2; m++)
+        {
+            double sum = 0.0;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(const char *pos = begin; pos < end; )
+            {
+                const char *lineEnd = (const char*)memchr( pos, '\n', end - pos );
+                if( m == 0 )
+                {
+                    mk_file_manager::mk_line source, target;
+                    unsigned long time, duration;
+                    double value;
+                    int integer;
+                    switch( k )
+                    {
+                    case 0:
+                        mk_file_manager::parse_token( pos, lineEnd, source );
+                        mk_file_manager::parse_token( pos, lineEnd, target );
+                        mk_file_manager::parse_ulong( pos, lineEnd, time );
+                        mk_file_manager::parse_ulong( pos, lineEnd, duration );
+                        sum += source._size + target._size + time + duration;
+                        while( mk_file_manager::parse_double(pos, lineEnd, value) )
+                            sum += value;
+                        break;
+                    case 1:
+                        mk_file_manager::parse_int( pos, lineEnd, integer );
+                        sum += integer;
+                        break;
+                    default:
+                        mk_file_manager::parse_double( pos, lineEnd, value );
+                        sum += value;
+                        break;
+                    }
+                }
+                else
+                {
+                    // former loader: line copied as by fgets(), sscanf() of the fixed columns,
+                    // strtod() of attributes
+                    char source[128], target[128], *next;
+                    unsigned long time, duration;
+                    int offset = 0;
+                    memcpy( line, pos, lineEnd + 1 - pos );
+                    line[lineEnd + 1 - pos] = '\0';
+                    switch( k )
+                    {
+                    case 0:
+                        if( sscanf(line, "%127s %127s %lu %lu%n", source, target, &time, &duration,
+                                   &offset) == 4 )
+                        {
+                            sum += strlen( source ) + strlen( target ) + time + duration;
+                            const char *attribute = line + offset;
+                            while( true )
+                            {
+                                double value = strtod( attribute, &next );
+                                if( next == attribute )
+                                    break;
+                                sum += value;
+                                attribute = next;
+                            }
+                        }
+                        break;
+                    case 1:
+                        sum += atoi( line );
+                        break;
+                    default:
+                        sum += strtod( line, NULL );
+                        break;
+                    }
+                }
+                pos = lineEnd + 1;
+            }
+            seconds[m] = _seconds( start );
+            _sink += sum;
+        }
+        printf( "%-24s %14.1f %14.1f\n", names[k], mb/seconds[0], mb/seconds[1] );
+    }
+}
+
+/**
+ * @brief _bench_output  Prints rows/s of writing rows of 4 values with put(), put() in
+ *                       asynchronous mode and both put_rows(), against the former
+ *                       fprintf("%lg") path.
+ */
+static void _bench_output()
+{
+    const int numRows = 1000000, numCols = 4;
+    const std::string fileName = "file_manager_test_output.txt";
+    const char *methods[5] = {"put", "put (async)", "put_rows (rows)", "put_rows (matrix)",
+                              "fprintf %lg (old)"};
+    mk_random_generator rg( 42, mk_random_generator::Xoshiro256 );
+    std::vector<std::vector<double> > rows( numRows, std::vector<double>(numCols) );
+    std::vector<double> matrix( (size_t)numRows*numCols );
+    for(int r=0; r<numRows; r++)
+        for(int c=0; c<numCols; c++)
+            rows[r][c] = matrix[(size_t)r*numCols + c] = rg.double_normal( 0.0, 1000.0 );
+
+    printf( "\n%-24s %14s\n", "rows/s", "4 values" );
+    for(int m=0; m<5; m++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if( m < 4 )
+        {
+            mk_file_manager fm;
+            fm.write( fileName, m == 1 );
+            if( m < 2 )
+                for(int r=0; r<numRows; r++)
+                    fm.put( rows[r] );
+            else if( m == 2 )
+                fm.put_rows( rows );
+            else
+                fm.put_rows( &matrix[0], numRows, numCols );
+            fm.close();
+        }
+        else
+        {
+            FILE *file = fopen( fileName.c_str(), "w" );
+            for(int r=0; r<numRows; r++)
+            {
+                fprintf( file, "%lg", rows[r][0] );
+                for(int c=1; c<numCols; c++)
+                    fprintf( file, " %lg", rows[r][c] );
+                fprintf( file, "\n" );
+            }
+            fclose( file );
+        }
+        printf( "%-24s %14.0f\n", methods[m], numRows / _seconds(start) );
+    }
+    remove( fileName.c_str() );
+}
+
+
+int main( int argc, char **argv )
+{
+    if( argc > 1 && std::string(argv[1]) == "bench" )
+    {
+        _bench_parsers();
+        _bench_output();
+        return 0;
+    }
+
+    _check_fields();
+    _check_doubles();
+    _check_output();
+
+    printf( "%s: %d failed checks\n", argv[0], _failures );
+    return _failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,867 @@
+/* meerkat random generator test.
+ *
+ * Statistical checks and timings of mk_random_generator. Without arguments the checks are run
+ * (exit status is non-zero if any fails), with "bench" the timings are printed.
+ * All checks use fixed seeds, so their outcome is reproducible.
+ */
+
+#include "meerkat_random_generator.hpp"
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+using namespace meerkat;
+
+
+// engines to test
+static const mk_random_generator::Engine ENGINES[4] = {
+    mk_random_generator::MotherOfAll, mk_random_generator::Xoshiro256,
+    mk_random_generator::Pcg64, mk_random_generator::Philox
+};
+static const char *ENGINE_NAMES[4] = {"MotherOfAll", "Xoshiro256", "Pcg64", "Philox"};
+
+// number of failed checks
+static int _failures = 0;
+
+// keeps benchmarked results alive
+static volatile double _sink = 0.0;
+
+
+/**
+ * @brief _check       Prints the outcome of a check and counts failures.
+ * @param passed_      Outcome.
+ * @param name_        Name of the check.
+ * @param value_       Measured value.
+ * @param limit_       Limit of the value.
+ */
+static void _check( bool passed_, const char *name_, double value_, double limit_ )
+{
+    printf( "  %-52s %12.6g  (limit %.6g)  %s\n", name_, value_, limit_, passed_ ? "ok" : "FAILED" );
+    if( !passed_ )
+        _failures++;
+}
+
+/**
+ * @brief _chi_square_limit  Upper limit of a chi-square statistic at significance 1e-4
+ *                           (Wilson-Hilferty approximation).
+ * @param df_                Degrees of freedom.
+ * @return                   The limit.
+ */
+static double _chi_square_limit( int df_ )
+{
+    double a = 2.0 / (9.0*df_);
+    double b = 1.0 - a + 3.719*sqrt( a );
+    return df_ * b*b*b;
+}
+
+/**
+ * @brief _chi_square  Chi-square statistic of counts against equal expected counts.
+ * @param counts_      Observed counts.
+ * @param total_       Number of samples.
+ * @return             The statistic.
+ */
+static double _chi_square( const std::vector<long> &counts_, long total_ )
+{
+    double expected = (double)total_ / counts_.size(), chi = 0.0;
+    for(size_t i=0; i<counts_.size(); i++)
+        chi += (counts_[i]-expected) * (counts_[i]-expected) / expected;
+    return chi;
+}
+
+/**
+ * @brief _ks        Kolmogorov-Smirnov statistic of a sample against a distribution.
+ * @param sample_    Sample, it is sorted.
+ * @param cdf_       Cumulative distribution function.
+ * @param param_     Parameter of the distribution function.
+ * @return           The statistic.
+ */
+static double _ks( std::vector<double> &sample_, double (*cdf_)(double, double), double param_ )
+{
+    std::sort( sample_.begin(), sample_.end() );
+    double n = (double)sample_.size(), d = 0.0;
+    for(size_t i=0; i<sample_.size(); i++)
+    {
+        double f = cdf_( sample_[i], param_ );
+        d = std::max( d, std::max(f - i/n, (i+1)/n - f) );
+    }
+    return d;
+}
+
+/**
+ * @brief _ks_limit  Upper limit of the Kolmogorov-Smirnov statistic at significance 1e-3.
+ * @param n_         Sample size.
+ * @return           The limit.
+ */
+static double _ks_limit( size_t n_ )
+{
+    return 1.949 / sqrt( (double)n_ );
+}
+
+// distribution functions: standard normal, standard normal beyond r_, exponential with rate 1
+static double _normal_cdf( double x_, double )
+{
+    return 0.5 * erfc( -x_ / sqrt(2.0) );
+}
+
+static double _normal_tail_cdf( double x_, double r_ )
+{
+    return 1.0 - erfc( x_/sqrt(2.0) ) / erfc( r_/sqrt(2.0) );
+}
+
+static double _exponential_cdf( double x_, double )
+{
+    return 1.0 - exp( -x_ );
+}
+
+/**
+ * @brief _seconds  Returns the time elapsed since a time point.
+ * @param start_    Start time.
+ * @return          Elapsed time in seconds.
+ */
+static double _seconds( const std::chrono::steady_clock::time_point &start_ )
+{
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - start_ ).count();
+}
+
+
+// checks
+
+/**
+ * @brief _check_engine  Chi-square of each byte of bits64() and of double_uniform() in 1000
+ *                       bins, mean and variance of double_normal().
+ * @param e_             Index of the engine.
+ */
+static void _check_engine( int e_ )
+{
+    const long n = 2000000;
+    char name[128];
+    printf( "%s\n", ENGINE_NAMES[e_] );
+
+    mk_random_generator rg( 42, ENGINES[e_] );
+    std::vector<std::vector<long> > bytes( 8, std::vector<long>(256, 0) );
+    for(long i=0; i<n; i++)
+    {
+        uint64_t r = rg.bits64();
+        for(int b=0; b<8; b++)
+            bytes[b][(r >> (8*b)) & 255]++;
+    }
+    for(int b=0; b<8; b++)
+    {
+        double chi = _chi_square( bytes[b], n ), limit = _chi_square_limit( 255 );
+        sprintf( name, "bits64 byte %d chi-square (255 df)", b );
+        _check( chi < limit, name, chi, limit );
+    }
+
+    std::vector<long> bins( 1000, 0 );
+    for(long i=0; i<n; i++)
+    {
+        double u = rg.double_uniform( 0.0, 1.0 );
+        if( u < 0.0 || u >= 1.0 )
+        {
+            _check( false, "double_uniform in [0, 1)", u, 1.0 );
+            return;
+        }
+        bins[(int)(u*1000.0)]++;
+    }
+    double chi = _chi_square( bins, n ), limit = _chi_square_limit( 999 );
+    _check( chi < limit, "double_uniform chi-square (999 df)", chi, limit );
+
+    double sum = 0.0, sum2 = 0.0;
+    for(long i=0; i<n; i++)
+    {
+        double x = rg.double_normal( 0.0, 1.0 );
+        sum += x;
+        sum2 += x*x;
+    }
+    double mean = sum / n, var = sum2/n - mean*mean;
+    _check( fabs(mean) < 5.0/sqrt((double)n), "double_normal mean", mean, 5.0/sqrt((double)n) );
+    _check( fabs(var-1.0) < 5.0*sqrt(2.0/n), "double_normal variance - 1", var-1.0,
+            5.0*sqrt(2.0/n) );
+}
+
+/**
+ * @brief _check_streams  Checks that streams do not overlap: no 64-bit output of a window of
+ *                        one stream occurs in the windows of the others. Jumped generators are
+ *                        checked for the engines supporting jump(), created streams for all.
+ *                        Also checks that create_streams() gives the same generators as
+ *                        seeding each stream separately.
+ * @param e_              Index of the engine.
+ */
+static void _check_streams( int e_ )
+{
+    const int numStreams = 8, window = 250000;
+    printf( "%s streams\n", ENGINE_NAMES[e_] );
+
+    std::vector<mk_random_generator> streams;
+    mk_random_generator::create_streams( 7, numStreams, ENGINES[e_], streams );
+    int mismatches = 0;
+    for(int s=0; s<numStreams; s++)
+    {
+        mk_random_generator single( (uint64_t)7, (uint64_t)s, ENGINES[e_] );
+        mk_random_generator created = streams[s];
+        for(int i=0; i<1000; i++)
+            if( single.bits64() != created.bits64() )
+                mismatches++;
+    }
+    _check( mismatches == 0, "create_streams equals init_stream (mismatches)", mismatches, 0 );
+
+    std::unordered_set<uint64_t> seen;
+    seen.reserve( 2*numStreams*window );
+    long repeats = 0;
+    for(int s=0; s<numStreams; s++)
+        for(int i=0; i<window; i++)
+            if( !seen.insert(streams[s].bits64()).second )
+                repeats++;
+    _check( repeats == 0, "create_streams repeated outputs", repeats, 0 );
+
+    if( ENGINES[e_] == mk_random_generator::Xoshiro256 || ENGINES[e_] == mk_random_generator::Pcg64 )
+    {
+        mk_random_generator rg( 7, ENGINES[e_] );
+        seen.clear();
+        repeats = 0;
+        for(int s=0; s<numStreams; s++)
+        {
+            mk_random_generator copy = rg;
+            for(int i=0; i<window; i++)
+                if( !seen.insert(copy.bits64()).second )
+                    repeats++;
+            rg.jump();
+        }
+        _check( repeats == 0, "jump repeated outputs", repeats, 0 );
+    }
+}
+
+/**
+ * @brief _check_ziggurat  Moments and Kolmogorov-Smirnov statistic of double_normal() and
+ *                         double_exponential(), and the same for the tails beyond the last
+ *                         layer (R = 3.4426 for the normal, R = 7.6971 for the exponential),
+ *                         where the samples are drawn by the fallback methods.
+ * @param e_               Index of the engine.
+ */
+static void _check_ziggurat( int e_ )
+{
+    const long n = 10000000;
+    const double rNormal = 3.442619855899, rExp = 7.69711747013104972;
+    printf( "%s ziggurat\n", ENGINE_NAMES[e_] );
+
+    mk_random_generator rg( 42, ENGINES[e_] );
+    std::vector<double> sample( n ), tail;
+    double m[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+    for(long i=0; i<n; i++)
+    {
+        double x = rg.double_normal( 0.0, 1.0 ), p = 1.0;
+        sample[i] = x;
+        for(int k=1; k<5; k++)
+            m[k] += (p *= x);
+        if( fabs(x) > rNormal )
+            tail.push_back( fabs(x) );
+    }
+    for(int k=1; k<5; k++)
+        m[k] /= n;
+    double var = m[2] - m[1]*m[1], skew = m[3] / pow(var, 1.5), kurt = m[4]/(var*var) - 3.0;
+    _check( fabs(m[1]) < 5.0*sqrt(1.0/n), "normal mean", m[1], 5.0*sqrt(1.0/n) );
+    _check( fabs(var-1.0) < 5.0*sqrt(2.0/n), "normal variance - 1", var-1.0, 5.0*sqrt(2.0/n) );
+    _check( fabs(skew) < 5.0*sqrt(6.0/n), "normal skewness", skew, 5.0*sqrt(6.0/n) );
+    _check( fabs(kurt) < 5.0*sqrt(24.0/n), "normal excess kurtosis", kurt, 5.0*sqrt(24.0/n) );
+    double d = _ks( sample, _normal_cdf, 0.0 );
+    _check( d < _ks_limit(n), "normal KS", d, _ks_limit(n) );
+    double p = erfc( rNormal/sqrt(2.0) ), sd = sqrt( n*p*(1.0-p) );
+    _check( fabs(tail.size() - n*p) < 5.0*sd, "normal tail count - expected",
+            tail.size() - n*p, 5.0*sd );
+    d = _ks( tail, _normal_tail_cdf, rNormal );
+    _check( d < _ks_limit(tail.size()), "normal tail KS", d, _ks_limit(tail.size()) );
+
+    tail.clear();
+    m[1] = m[2] = 0.0;
+    for(long i=0; i<n; i++)
+    {
+        double x = rg.double_exponential( 1.0 );
+        sample[i] = x;
+        m[1] += x;
+        m[2] += x*x;
+        if( x > rExp )
+            tail.push_back( x - rExp );
+    }
+    m[1] /= n;
+    m[2] /= n;
+    var = m[2] - m[1]*m[1];
+    _check( fabs(m[1]-1.0) < 5.0*sqrt(1.0/n), "exponential mean - 1", m[1]-1.0, 5.0*sqrt(1.0/n) );
+    _check( fabs(var-1.0) < 5.0*sqrt(8.0/n), "exponential variance - 1", var-1.0,
+            5.0*sqrt(8.0/n) );
+    d = _ks( sample, _exponential_cdf, 0.0 );
+    _check( d < _ks_limit(n), "exponential KS", d, _ks_limit(n) );
+    p = exp( -rExp );
+    sd = sqrt( n*p*(1.0-p) );
+    _check( fabs(tail.size() - n*p) < 5.0*sd, "exponential tail count - expected",
+            tail.size() - n*p, 5.0*sd );
+    d = _ks( tail, _exponential_cdf, 0.0 );
+    _check( d < _ks_limit(tail.size()), "exponential tail KS (shifted by R)", d,
+            _ks_limit(tail.size()) );
+}
+
+/**
+ * @brief _check_moments  Checks mean and variance of an integer sample.
+ * @param name_           Name of the sampled distribution.
+ * @param sample_         Sample.
+ * @param mean_           Expected mean.
+ * @param var_            Expected variance.
+ * @param mu4_            Expected fourth central moment (for the error of the variance).
+ */
+static void _check_moments( const char *name_, const std::vector<int> &sample_, double mean_,
+                            double var_, double mu4_ )
+{
+    double n = (double)sample_.size(), sum = 0.0, sum2 = 0.0;
+    for(size_t i=0; i<sample_.size(); i++)
+    {
+        double d = sample_[i] - mean_;
+        sum += d;
+        sum2 += d*d;
+    }
+    double mean = sum / n, var = sum2/n - mean*mean;
+    char name[128];
+    sprintf( name, "%s mean - expected", name_ );
+    _check( fabs(mean) < 5.0*sqrt(var_/n), name, mean, 5.0*sqrt(var_/n) );
+    sprintf( name, "%s variance - expected", name_ );
+    _check( fabs(var-var_) < 5.0*sqrt((mu4_-var_*var_)/n), name, var-var_,
+            5.0*sqrt((mu4_-var_*var_)/n) );
+}
+
+/**
+ * @brief _check_discrete  Checks mean and variance of integer_poisson() and integer_binomial()
+ *                         on both sides of the switch to transformed rejection (lambda = 10
+ *                         and n*min(p, 1-p) = 10), and far from it.
+ */
+static void _check_discrete()
+{
+    const int n = 2000000;
+    const double lambdas[6] = {0.5, 9.99, 10.0, 10.01, 100.0, 10000.0};
+    const double probs[6] = {0.00999, 0.01, 0.99001, 0.99, 0.5, 0.3};
+    const int trials = 1000;
+    char name[128];
+    printf( "Poisson and binomial\n" );
+
+    mk_random_generator rg( 42, mk_random_generator::Xoshiro256 );
+    std::vector<int> sample( n );
+    for(int l=0; l<6; l++)
+    {
+        double lambda = lambdas[l];
+        for(int i=0; i<n; i++)
+            sample[i] = rg.integer_poisson( lambda );
+        sprintf( name, "poisson(%g)", lambda );
+        _check_moments( name, sample, lambda, lambda, lambda + 3.0*lambda*lambda );
+    }
+    for(int q=0; q<6; q++)
+    {
+        double p = probs[q], v = trials*p*(1.0-p);
+        for(int i=0; i<n; i++)
+            sample[i] = rg.integer_binomial( trials, p );
+        sprintf( name, "binomial(%d, %g)", trials, p );
+        _check_moments( name, sample, trials*p, v, v*(1.0 + 3.0*(trials-2)*p*(1.0-p)) );
+    }
+}
+
+/**
+ * @brief _inclusion_statistic  Chi-square like statistic of inclusion counts, each element
+ *                              should be included with probability k/n.
+ * @param counts_               Number of times each element was included.
+ * @param k_                    Sample size.
+ * @param trials_               Number of samples drawn.
+ * @return                      The statistic, approximately chi-square with n-1 degrees of
+ *                              freedom.
+ */
+static double _inclusion_statistic( const std::vector<long> &counts_, int k_, long trials_ )
+{
+    double p = (double)k_ / counts_.size(), expected = trials_*p, chi = 0.0;
+    for(size_t i=0; i<counts_.size(); i++)
+        chi += (counts_[i]-expected) * (counts_[i]-expected) / (expected*(1.0-p));
+    return chi;
+}
+
+/**
+ * @brief _check_sampling  Checks that integer_sample() (Floyd) and reservoir_sample()
+ *                         (algorithm L) include each element with equal frequency, and that
+ *                         shuffle() and partial_shuffle() put each element at each front
+ *                         position with equal frequency.
+ */
+static void _check_sampling()
+{
+    const int sizes[3][2] = {{20, 1}, {20, 5}, {1000, 10}};
+    const long trials = 200000;
+    char name[128];
+    printf( "Sampling\n" );
+
+    mk_random_generator rg( 42, mk_random_generator::Xoshiro256 );
+    std::vector<int> sample, population;
+    for(int c=0; c<3; c++)
+    {
+        int n = sizes[c][0], k = sizes[c][1];
+        population.resize( n );
+        for(int i=0; i<n; i++)
+            population[i] = i;
+
+        std::vector<long> floyd( n, 0 ), reservoir( n, 0 );
+        long invalid = 0;
+        for(long t=0; t<trials; t++)
+        {
+            rg.integer_sample( n, k, sample );
+            std::unordered_set<int> distinct( sample.begin(), sample.end() );
+            if( (int)sample.size() != k || (int)distinct.size() != k )
+                invalid++;
+            for(size_t i=0; i<sample.size(); i++)
+                floyd[sample[i]]++;
+
+            rg.reservoir_sample( population.begin(), population.end(), k, sample );
+            distinct = std::unordered_set<int>( sample.begin(), sample.end() );
+            if( (int)sample.size() != k || (int)distinct.size() != k )
+                invalid++;
+            for(size_t i=0; i<sample.size(); i++)
+                reservoir[sample[i]]++;
+        }
+        sprintf( name, "n=%d, k=%d samples with wrong size or repeats", n, k );
+        _check( invalid == 0, name, invalid, 0 );
+        double chi = _inclusion_statistic( floyd, k, trials ), limit = _chi_square_limit( n-1 );
+        sprintf( name, "integer_sample n=%d, k=%d inclusion (%d df)", n, k, n-1 );
+        _check( chi < limit, name, chi, limit );
+        chi = _inclusion_statistic( reservoir, k, trials );
+        sprintf( name, "reservoir_sample n=%d, k=%d inclusion (%d df)", n, k, n-1 );
+        _check( chi < limit, name, chi, limit );
+    }
+
+    // element i at position j, for all positions (shuffle) or the first k (partial_shuffle)
+    const int n = 10, k = 4;
+    std::vector<long> full( n*n, 0 ), partial( n*k, 0 );
+    for(long t=0; t<trials; t++)
+    {
+        for(int i=0; i<n; i++)
+            population[i] = i;
+        rg.shuffle( population.begin(), population.begin()+n );
+        for(int j=0; j<n; j++)
+            full[population[j]*n + j]++;
+
+        for(int i=0; i<n; i++)
+            population[i] = i;
+        rg.partial_shuffle( population.begin(), population.begin()+n, k );
+        for(int j=0; j<k; j++)
+            partial[population[j]*k + j]++;
+    }
+    double chi = _chi_square( full, trials*n ), limit = _chi_square_limit( (n-1)*(n-1) );
+    _check( chi < limit, "shuffle n=10 element by position (81 df)", chi, limit );
+    chi = _chi_square( partial, trials*k );
+    limit = _chi_square_limit( (n-1)*k );
+    _check( chi < limit, "partial_shuffle n=10, k=4 element by position (36 df)", chi, limit );
+}
+
+/**
+ * @brief _check_dynamic_table  Checks that sampling frequencies of a dynamic table follow the
+ *                              weights after a series of update() calls, including weights set
+ *                              to and from zero.
+ */
+static void _check_dynamic_table()
+{
+    const int n = 50, updates = 1000;
+    const long trials = 4000000;
+    printf( "Dynamic table\n" );
+
+    mk_random_generator rg( 42, mk_random_generator::Xoshiro256 );
+    std::vector<double> weights( n );
+    for(int i=0; i<n; i++)
+        weights[i] = rg.double_uniform( 0.0, 1.0 );
+    mk_random_generator::mk_dynamic_table table;
+    table.setup( weights );
+    for(int u=0; u<updates; u++)
+    {
+        int i = rg.integer_uniform( 0, n-1 );
+        weights[i] = rg.double_uniform( 0.0, 1.0 ) < 0.2 ? 0.0 : rg.double_uniform( 0.0, 10.0 );
+        table.update( i, weights[i] );
+    }
+
+    double total = 0.0, error = 0.0;
+    for(int i=0; i<n; i++)
+    {
+        total += weights[i];
+        error = std::max( error, fabs(table.weight(i) - weights[i]) );
+    }
+    _check( error == 0.0, "weight() after updates - weight", error, 0.0 );
+    _check( fabs(table.total() - total) < 1e-9*total, "total() after updates - sum of weights",
+            table.total() - total, 1e-9*total );
+
+    std::vector<long> counts( n, 0 );
+    for(long t=0; t<trials; t++)
+        counts[rg.sample_dynamic_table( table )]++;
+    long zeros = 0;
+    int df = -1;
+    double chi = 0.0;
+    for(int i=0; i<n; i++)
+    {
+        if( weights[i] == 0.0 )
+        {
+            zeros += counts[i];
+            continue;
+        }
+        double expected = trials * weights[i] / total;
+        chi += (counts[i]-expected) * (counts[i]-expected) / expected;
+        df++;
+    }
+    _check( zeros == 0, "samples of zero weights", zeros, 0 );
+    char name[128];
+    sprintf( name, "frequencies after updates chi-square (%d df)", df );
+    _check( chi < _chi_square_limit(df), name, chi, _chi_square_limit(df) );
+}
+
+
+// benchmarks
+
+/**
+ * @brief _bench_engines  Prints ns/sample of bits64(), double_uniform() and double_normal() for
+ *                        each engine, and the ratio to MotherOfAll.
+ */
+static void _bench_engines()
+{
+    const long n = 20000000;
+    const char *methods[3] = {"bits64", "double_uniform", "double_normal"};
+    double ns[4][3];
+    for(int e=0; e<4; e++)
+    {
+        mk_random_generator rg( 42, ENGINES[e] );
+        for(int m=0; m<3; m++)
+        {
+            double sum = 0.0;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            switch( m )
+            {
+            case 0:
+                for(long i=0; i<n; i++)
+                    sum += (double)(rg.bits64() >> 11);
+                break;
+            case 1:
+                for(long i=0; i<n; i++)
+                    sum += rg.double_uniform( 0.0, 1.0 );
+                break;
+            default:
+                for(long i=0; i<n; i++)
+                    sum += rg.double_normal( 0.0, 1.0 );
+                break;
+            }
+            ns[e][m] = 1e9 * _seconds( start ) / n;
+            _sink += sum;
+        }
+    }
+
+    printf( "%-16s", "ns/sample" );
+    for(int e=0; e<4; e++)
+        printf( " %20s", ENGINE_NAMES[e] );
+    printf( "\n" );
+    for(int m=0; m<3; m++)
+    {
+        printf( "%-16s", methods[m] );
+        for(int e=0; e<4; e++)
+            printf( " %9.2f (x%6.2f)", ns[e][m], ns[0][m]/ns[e][m] );
+        printf( "\n" );
+    }
+    printf( "(x: speed-up relative to MotherOfAll)\n" );
+}
+
+/**
+ * @brief _bench_ziggurat  Prints ns/sample of the ziggurat samplers against the former methods:
+ *                         Box-Muller (one sample from two uniforms) for the normal and
+ *                         -log(u) for the exponential.
+ */
+static void _bench_ziggurat()
+{
+    const long n = 20000000;
+    const char *methods[4] = {"double_normal", "Box-Muller (old)", "double_exponential",
+                              "-log(u)"};
+    double ns[4][4];
+    for(int e=0; e<4; e++)
+    {
+        mk_random_generator rg( 42, ENGINES[e] );
+        for(int m=0; m<4; m++)
+        {
+            double sum = 0.0;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            switch( m )
+            {
+            case 0:
+                for(long i=0; i<n; i++)
+                    sum += rg.double_normal( 0.0, 1.0 );
+                break;
+            case 1:
+                for(long i=0; i<n; i++)
+                {
+                    double u = rg.double_uniform( 0.0, 1.0 ), v = rg.double_uniform( 0.0, 1.0 );
+                    sum += sqrt( -2.0*log(u) ) * cos( 6.28318*v );
+                }
+                break;
+            case 2:
+                for(long i=0; i<n; i++)
+                    sum += rg.double_exponential( 1.0 );
+                break;
+            default:
+                for(long i=0; i<n; i++)
+                    sum += -log( 1.0 - rg.double_uniform(0.0, 1.0) );
+                break;
+            }
+            ns[e][m] = 1e9 * _seconds( start ) / n;
+            _sink += sum;
+        }
+    }
+
+    printf( "\n%-20s", "ns/sample" );
+    for(int e=0; e<4; e++)
+        printf( " %12s", ENGINE_NAMES[e] );
+    printf( "\n" );
+    for(int m=0; m<4; m++)
+    {
+        printf( "%-20s", methods[m] );
+        for(int e=0; e<4; e++)
+            printf( " %12.2f", ns[e][m] );
+        printf( "\n" );
+    }
+    printf( "ziggurat speed-up: normal" );
+    for(int e=0; e<4; e++)
+        printf( " x%.2f", ns[e][1]/ns[e][0] );
+    printf( ", exponential" );
+    for(int e=0; e<4; e++)
+        printf( " x%.2f", ns[e][3]/ns[e][2] );
+    printf( "\n" );
+}
+
+/**
+ * @brief _bench_discrete  Prints ns/sample of integer_poisson() for a range of lambda against the
+ *                         former multiplication method, and of integer_binomial() for a range
+ *                         of n*p against counting n Bernoulli trials.
+ */
+static void _bench_discrete()
+{
+    const long n = 2000000;
+    const double lambdas[9] = {1.0, 5.0, 9.0, 9.99, 10.0, 20.0, 50.0, 100.0, 1000.0};
+    const int trials[9] = {100, 500, 900, 999, 1000, 2000, 5000, 10000, 100000};
+    mk_random_generator rg( 42, mk_random_generator::Xoshiro256 );
+
+    printf( "\n%-10s %18s %18s\n", "lambda", "integer_poisson", "multiplication" );
+    for(int l=0; l<9; l++)
+    {
+        double lambda = lambdas[l], sum = 0.0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(long i=0; i<n; i++)
+            sum += rg.integer_poisson( lambda );
+        double ns = 1e9 * _seconds( start ) / n;
+
+        // former method, its cost grows with lambda and exp(-lambda) underflows above ~700
+        double L = exp( -lambda ), nsOld = -1.0;
+        long m = lambda < 700.0 ? n/10 : 0;
+        start = std::chrono::steady_clock::now();
+        for(long i=0; i<m; i++)
+        {
+            int k = 0;
+            double p = 1.0;
+            do
+            {
+                k++;
+                p *= rg.double_uniform( 0.0, 1.0 );
+            } while( p > L );
+            sum += k-1;
+        }
+        if( m > 0 )
+            nsOld = 1e9 * _seconds( start ) / m;
+        _sink += sum;
+        if( nsOld > 0.0 )
+            printf( "%-10g %18.2f %18.2f\n", lambda, ns, nsOld );
+        else
+            printf( "%-10g %18.2f %18s\n", lambda, ns, "-" );
+    }
+
+    printf( "\n%-10s %18s %18s\n", "n*p", "integer_binomial", "Bernoulli trials" );
+    for(int t=0; t<9; t++)
+    {
+        double sum = 0.0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(long i=0; i<n; i++)
+            sum += rg.integer_binomial( trials[t], 0.01 );
+        double ns = 1e9 * _seconds( start ) / n;
+
+        long m = n / 100;
+        start = std::chrono::steady_clock::now();
+        for(long i=0; i<m; i++)
+        {
+            int k = 0;
+            for(int j=0; j<trials[t]; j++)
+                k += rg.double_uniform( 0.0, 1.0 ) < 0.01;
+            sum += k;
+        }
+        double nsOld = 1e9 * _seconds( start ) / m;
+        _sink += sum;
+        printf( "%-10g %18.2f %18.2f\n", trials[t]*0.01, ns, nsOld );
+    }
+    printf( "(ns/sample, transformed rejection above lambda = 10 and n*p = 10)\n" );
+}
+
+/**
+ * @brief _old_shuffle  Former integer_shuffle(): 10n swaps of random pairs.
+ * @param rg_           Generator to use.
+ * @param vec_          Vector to shuffle.
+ */
+static void _old_shuffle( mk_random_generator &rg_, std::vector<int> &vec_ )
+{
+    int n = (int)vec_.size(), swaps = 10*n;
+    if( n < 2 )
+        return;
+    while( swaps > 0 )
+    {
+        int v1 = rg_.integer_uniform( 0, n-1 ), v2 = rg_.integer_uniform( 0, n-1 );
+        if( v1 != v2 )
+        {
+            std::swap( vec_[v1], vec_[v2] );
+            swaps--;
+        }
+    }
+}
+
+/**
+ * @brief _bench_sampling  Prints the time of shuffling a vector and of drawing k of its elements
+ *                         with the new methods against the former 10n-swap shuffle (and taking
+ *                         its first k elements).
+ */
+static void _bench_sampling()
+{
+    const int n = 100000, ks[3] = {10, 1000, 50000};
+    mk_random_generator rg( 42, mk_random_generator::Xoshiro256 );
+    std::vector<int> vec( n ), sample;
+    for(int i=0; i<n; i++)
+        vec[i] = i;
+
+    printf( "\n%-36s %12s\n", "us/call, n = 100000", "" );
+    for(int m=0; m<2; m++)
+    {
+        int reps = m == 0 ? 200 : 10;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(int r=0; r<reps; r++)
+        {
+            if( m == 0 )
+                rg.shuffle( vec.begin(), vec.end() );
+            else
+                _old_shuffle( rg, vec );
+            _sink += vec[0];
+        }
+        printf( "%-36s %12.1f\n", m == 0 ? "shuffle" : "10n swaps (old)", 1e6*_seconds(start)/reps );
+    }
+
+    const char *methods[5] = {"partial_shuffle", "integer_sample", "reservoir_sample",
+                              "shuffle, take k", "10n swaps, take k (old)"};
+    printf( "\n%-36s", "us/call, n = 100000" );
+    for(int c=0; c<3; c++)
+        printf( "    k = %5d", ks[c] );
+    printf( "\n" );
+    for(int m=0; m<5; m++)
+    {
+        printf( "%-36s", methods[m] );
+        for(int c=0; c<3; c++)
+        {
+            int k = ks[c], reps = m == 4 ? 10 : (m < 2 ? 20000000/(k+100) : 200);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(int r=0; r<reps; r++)
+            {
+                switch( m )
+                {
+                case 0:
+                    rg.partial_shuffle( vec.begin(), vec.end(), k );
+                    sample.assign( vec.begin(), vec.begin()+k );
+                    break;
+                case 1:
+                    rg.integer_sample( n, k, sample );
+                    break;
+                case 2:
+                    rg.reservoir_sample( vec.begin(), vec.end(), k, sample );
+                    break;
+                case 3:
+                    rg.shuffle( vec.begin(), vec.end() );
+                    sample.assign( vec.begin(), vec.begin()+k );
+                    break;
+                default:
+                    _old_shuffle( rg, vec );
+                    sample.assign( vec.begin(), vec.begin()+k );
+                    break;
+                }
+                _sink += sample[0];
+            }
+            printf( " %12.1f", 1e6*_seconds(start)/reps );
+        }
+        printf( "\n" );
+    }
+}
+
+/**
+ * @brief _bench_dynamic_table  Prints the time of changing one weight and drawing one sample with
+ *                              a dynamic table against rebuilding an alias table after each
+ *                              change.
+ */
+static void _bench_dynamic_table()
+{
+    const int sizes[4] = {10, 100, 10000, 1000000};
+    mk_random_generator rg( 42, mk_random_generator::Xoshiro256 );
+
+    printf( "\n%-36s %16s %16s\n", "ns/(update + sample)", "dynamic table", "alias rebuild" );
+    for(int c=0; c<4; c++)
+    {
+        int n = sizes[c];
+        std::vector<double> weights( n );
+        for(int i=0; i<n; i++)
+            weights[i] = rg.double_uniform( 0.0, 1.0 );
+        mk_random_generator::mk_dynamic_table dynamic;
+        mk_random_generator::mk_alias_table alias;
+        dynamic.setup( weights );
+        alias.setup( weights );
+
+        long reps = 4000000;
+        double sum = 0.0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(long r=0; r<reps; r++)
+        {
+            dynamic.update( (int)(r % n), rg.double_uniform(0.0, 1.0) );
+            sum += rg.sample_dynamic_table( dynamic );
+        }
+        double ns = 1e9 * _seconds( start ) / reps;
+
+        reps = std::max( 20L, 40000000L/n );
+        start = std::chrono::steady_clock::now();
+        for(long r=0; r<reps; r++)
+        {
+            weights[r % n] = rg.double_uniform( 0.0, 1.0 );
+            alias.setup( weights );
+            sum += rg.sample_alias_table( alias );
+        }
+        double nsAlias = 1e9 * _seconds( start ) / reps;
+        _sink += sum;
+
+        char name[64];
+        sprintf( name, "n = %d", n );
+        printf( "%-36s %16.1f %16.1f\n", name, ns, nsAlias );
+    }
+}
+
+
+int main( int argc, char **argv )
+{
+    if( argc > 1 && std::string(argv[1]) == "bench" )
+    {
+        _bench_engines();
+        _bench_ziggurat();
+        _bench_discrete();
+        _bench_sampling();
+        _bench_dynamic_table();
+        return 0;
+    }
+
+    for(int e=0; e<4; e++)
+        _check_engine( e );
+    for(int e=0; e<4; e++)
+        _check_streams( e );
+    for(int e=0; e<4; e++)
+        _check_ziggurat( e );
+    _check_discrete();
+    _check_sampling();
+    _check_dynamic_table();
+
+    printf( "%s: %d failed checks\n", argv[0], _failures );
+    return _failures == 0 ? 0 : 1;
+}